@@ -0,0 +1,928 @@
+#include "Analysis.h"
+
+#include "Formatter.h"
+#include "Machine.h"
+#include "Statistics.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace chip8 {
+
+	/*
+	a register with more values than this gets every value, unlike counting joins
+	this does not depend on the order the code is visited in, so the registers
+	and with them the targets of JP V0 come out the same however the analysis got there
+	*/
+	static const uint32_t WIDEN_VALUES = Analysis::MAX_JUMP_TARGETS;
+	/* after this many joins at one instruction, I gets every address if it still grows */
+	static const uint32_t WIDEN_AFTER = 8;
+	/* register pairs with more combinations than this are not enumerated */
+	static const uint32_t MAX_COMBINATIONS = 1024;
+
+	static void Widen(Analysis::Values& state) {
+		for (ValueSet& v : state.v) {
+			if (v.Count() > WIDEN_VALUES) {
+				v = ValueSet::All();
+			}
+		}
+	}
+
+	static bool Join(Analysis::Values& into, const Analysis::Values& from, bool widen) {
+		bool grown = false;
+		for (int r = 0; r < 16; r++) {
+			if (into.v[r].Join(from.v[r])) {
+				grown = true;
+				if (into.v[r].Count() > WIDEN_VALUES) {
+					into.v[r] = ValueSet::All();
+				}
+			}
+		}
+		if (into.i.Join(from.i)) {
+			grown = true;
+			if (widen) {
+				into.i = AddressSet::All();
+			}
+		}
+		return grown;
+	}
+
+	static bool IsFeasible(const Analysis::Values& state) {
+		for (const ValueSet& v : state.v) {
+			if (v.IsEmpty()) return false;
+		}
+		return true;
+	}
+
+	/*
+	Will apply op to every pair of values, collecting the results and the flags,
+	too many pairs give every value and both flags
+	*/
+	template <typename F>
+	static void Combine(const ValueSet& a, const ValueSet& b, ValueSet& result, ValueSet& flag, F op) {
+		if (a.Count() * b.Count() > MAX_COMBINATIONS) {
+			result = ValueSet::All();
+			flag = ValueSet::Range(0, 1);
+			return;
+		}
+		result = ValueSet();
+		flag = ValueSet();
+		a.ForEach([&](uint8_t x) {
+			b.ForEach([&](uint8_t y) {
+				uint8_t f = 0;
+				result.Insert(op(x, y, f));
+				flag.Insert(f);
+			});
+		});
+	}
+
+	/*
+	Will apply the effect of an instruction that does not change the control flow,
+	where the variants disagree every behaviour is included
+	*/
+	static void Transfer(const Opcode& opcode, Analysis::Values& s) {
+		const Operand& op1 = opcode.Operand1();
+		const Operand& op2 = opcode.Operand2();
+		auto reg = [](const Operand& op) { return (int)op.AsRegister(); };
+		auto general = [](const Operand& op) { return op.GetType() == OperandType::REGISTER && op.AsRegister() <= Register::VF; };
+
+		ValueSet result;
+		ValueSet flag;
+		switch (opcode.Type()) {
+			case OpcodeType::LD: {
+				if (general(op1)) {
+					int x = reg(op1);
+					if (op2.GetType() == OperandType::IMMEDIATE) {
+						s.v[x] = ValueSet::Of((uint8_t)op2.AsImmediate());
+					}
+					else if (general(op2)) {
+						s.v[x] = s.v[reg(op2)];
+					}
+					else if (op2.IsMemory()) {
+						for (int r = 0; r <= x; r++) {
+							s.v[r] = ValueSet::All();
+						}
+						s.i.Join(s.i.Offset((uint16_t)(x + 1)));
+					}
+					else {
+						s.v[x] = ValueSet::All();
+					}
+				}
+				else if (op1.AsRegister() == Register::I) {
+					if (op1.IsMemory()) {
+						s.i.Join(s.i.Offset((uint16_t)(reg(op2) + 1)));
+					}
+					else {
+						s.i = AddressSet::Of(op2.AsImmediate());
+					}
+				}
+			} break;
+			case OpcodeType::LD_LONG: s.i = AddressSet::Of(op2.AsImmediate()); break;
+			case OpcodeType::ADD: {
+				if (!general(op1)) {
+					s.i = s.i.Offset(s.v[reg(op2)]);
+				}
+				else if (op2.GetType() == OperandType::IMMEDIATE) {
+					s.v[reg(op1)] = s.v[reg(op1)].Offset((uint8_t)op2.AsImmediate());
+				}
+				else {
+					Combine(s.v[reg(op1)], s.v[reg(op2)], result, flag, [](uint8_t x, uint8_t y, uint8_t& f) { f = x + y > 0xFF ? 1 : 0; return (uint8_t)(x + y); });
+					s.v[reg(op1)] = result;
+					s.v[0xF] = flag;
+				}
+			} break;
+			case OpcodeType::OR:
+			case OpcodeType::AND:
+			case OpcodeType::XOR: {
+				OpcodeType type = opcode.Type();
+				Combine(s.v[reg(op1)], s.v[reg(op2)], result, flag, [type](uint8_t x, uint8_t y, uint8_t& f) {
+					f = 0;
+					return (uint8_t)(type == OpcodeType::OR ? x | y : type == OpcodeType::AND ? x & y : x ^ y);
+				});
+				/* VF is either kept or reset, after the result was written to it */
+				s.v[reg(op1)] = result;
+				s.v[0xF].Insert(0);
+			} break;
+			case OpcodeType::SUB: {
+				Combine(s.v[reg(op1)], s.v[reg(op2)], result, flag, [](uint8_t x, uint8_t y, uint8_t& f) { f = x >= y ? 1 : 0; return (uint8_t)(x - y); });
+				s.v[reg(op1)] = result;
+				s.v[0xF] = flag;
+			} break;
+			case OpcodeType::SUBN: {
+				Combine(s.v[reg(op1)], s.v[reg(op2)], result, flag, [](uint8_t x, uint8_t y, uint8_t& f) { f = y >= x ? 1 : 0; return (uint8_t)(y - x); });
+				s.v[reg(op1)] = result;
+				s.v[0xF] = flag;
+			} break;
+			case OpcodeType::SHR:
+			case OpcodeType::SHL: {
+				/* either Vx or Vy is shifted */
+				ValueSet source = s.v[reg(op1)];
+				source.Join(s.v[reg(op2)]);
+				bool right = opcode.Type() == OpcodeType::SHR;
+				source.ForEach([&](uint8_t value) {
+					result.Insert(right ? (uint8_t)(value >> 1) : (uint8_t)(value << 1));
+					flag.Insert(right ? (uint8_t)(value & 1) : (uint8_t)(value >> 7));
+				});
+				s.v[reg(op1)] = result;
+				s.v[0xF] = flag;
+			} break;
+			case OpcodeType::RND: {
+				uint8_t mask = (uint8_t)op2.AsImmediate();
+				for (uint32_t value = 0; value < 256; value++) {
+					result.Insert((uint8_t)value & mask);
+				}
+				s.v[reg(op1)] = result;
+			} break;
+			case OpcodeType::DRW: s.v[0xF] = ValueSet::Range(0, 1); break;
+			case OpcodeType::LD_KEY: s.v[reg(op1)] = ValueSet::Range(0, 15); break;
+			case OpcodeType::LD_FONT: s.i = AddressSet::Range(Machine::FONT_ADDRESS, Machine::FONT_ADDRESS + 15 * 5); break;
+			case OpcodeType::LD_HFONT: s.i = AddressSet::Range(Machine::HFONT_ADDRESS, Machine::HFONT_ADDRESS + 15 * 10); break;
+			case OpcodeType::LD_RPL_LOAD: {
+				for (int r = 0; r <= reg(op1); r++) {
+					s.v[r] = ValueSet::All();
+				}
+			} break;
+			case OpcodeType::LOAD: {
+				for (int r = std::min(reg(op1), reg(op2)); r <= std::max(reg(op1), reg(op2)); r++) {
+					s.v[r] = ValueSet::All();
+				}
+			} break;
+			default:
+				break;
+		}
+	}
+
+	/*
+	Return the register JP V0 takes its offset from with QUIRK_JUMP_VX
+	*/
+	static int JumpRegister(const Opcode& opcode) {
+		return (opcode.Operand1().AsImmediate() >> 8) & 0xF;
+	}
+
+	/*
+	Return every offset JP V0 may add, V0 or Vx depending on the quirk
+	*/
+	static ValueSet JumpOffsets(const Opcode& opcode, const Analysis::Values& state) {
+		ValueSet offsets = state.v[0];
+		offsets.Join(state.v[JumpRegister(opcode)]);
+		return offsets;
+	}
+
+	/*
+	Will add every address the values of an instruction can flow to, whatever
+	the values are, a RET flows to the given return sites
+	*/
+	static void FlowTargets(const Analysis::Instruction& ins, const std::vector<uint32_t>& sites, std::vector<uint32_t>& targets) {
+		const Opcode& opcode = ins.opcode;
+		if (!ins.error.empty()) {
+			return;
+		}
+		uint32_t next = ins.address + opcode.Length();
+		switch (opcode.Type()) {
+			case OpcodeType::JP: targets.push_back(opcode.Operand1().AsImmediate()); break;
+			case OpcodeType::JP_V0: {
+				for (uint32_t offset = 0; offset < 256; offset++) {
+					targets.push_back(opcode.Operand1().AsImmediate() + offset);
+				}
+			} break;
+			case OpcodeType::CALL: {
+				targets.push_back(opcode.Operand1().AsImmediate());
+				targets.push_back(next);
+			} break;
+			case OpcodeType::RET: targets.insert(targets.end(), sites.begin(), sites.end()); break;
+			case OpcodeType::EXIT: break;
+			case OpcodeType::SE:
+			case OpcodeType::SNE:
+			case OpcodeType::SKP:
+			case OpcodeType::SKNP: {
+				/* the skipped instruction may be 2 or 4 bytes */
+				targets.push_back(next);
+				targets.push_back(next + 2);
+				targets.push_back(next + 4);
+			} break;
+			default: targets.push_back(next); break;
+		}
+	}
+
+	/*
+	Return the amount of bytes an instruction reads or writes through I
+	*/
+	static uint32_t AccessLength(const Opcode& opcode) {
+		const Operand& op1 = opcode.Operand1();
+		const Operand& op2 = opcode.Operand2();
+		switch (opcode.Type()) {
+			case OpcodeType::DRW: {
+				uint16_t n = opcode.Operand3().AsImmediate();
+				return n == 0 ? 32 : n;
+			}
+			case OpcodeType::LD: {
+				if (op1.IsMemory()) return (uint32_t)op2.AsRegister() + 1;
+				if (op2.IsMemory()) return (uint32_t)op1.AsRegister() + 1;
+				return 0;
+			}
+			case OpcodeType::LD_BCD: return 3;
+			case OpcodeType::SAVE:
+			case OpcodeType::LOAD: {
+				int x = (int)op1.AsRegister();
+				int y = (int)op2.AsRegister();
+				return (uint32_t)(x < y ? y - x : x - y) + 1;
+			}
+			case OpcodeType::AUDIO: return 16;
+			default:
+				return 0;
+		}
+	}
+
+	Analysis::Analysis(const uint8_t* rom, size_t size, uint16_t base)
+		: image(rom, rom + size)
+		, base(base)
+		, roots(1, base)
+		, order()
+		, blocks()
+		, pages(0x10000 >> PAGE_SHIFT)
+		, visited(0x10000, 0)
+		, edges()
+		, preds()
+		, inserted()
+		, erased()
+		, values()
+		, jumps()
+		, data(0x10000, 0)
+		, regions()
+	{
+		Walk(std::vector<uint16_t>(roots.rbegin(), roots.rend()), {});
+		Update();
+	}
+
+	void Analysis::AddRoot(uint16_t address) {
+		if (std::find(roots.begin(), roots.end(), address) != roots.end()) {
+			return;
+		}
+		roots.push_back(address);
+		Walk({ address }, {});
+		Update();
+	}
+
+	size_t Analysis::AddRoots(const std::vector<uint16_t>& addresses) {
+		size_t added = 0;
+		for (uint16_t address : addresses) {
+			if (IsCode(address) || std::find(roots.begin(), roots.end(), address) != roots.end()) {
+				continue;
+			}
+			roots.push_back(address);
+			Walk({ address }, {});
+			added++;
+		}
+		if (added > 0) {
+			Update();
+		}
+		return added;
+	}
+
+	void Analysis::Patch(uint32_t address, const uint8_t* bytes, size_t size) {
+		if (size == 0) {
+			return;
+		}
+		uint32_t end = address + (uint32_t)size;
+		if (address < base || end > 0x10000) {
+			throw std::runtime_error(Formatter() << "Attempted to patch outside of the image [address=" << std::hex << address << ", size=" << std::hex << size << "]");
+		}
+
+		bool grown = false;
+		if (end - base > image.size()) {
+			image.resize(end - base, 0);
+			grown = true;
+		}
+		memcpy(&image[address - base], bytes, size);
+
+		std::vector<uint16_t> dirty;
+		for (uint32_t page = address >> PAGE_SHIFT; page <= ((end - 1) >> PAGE_SHIFT); page++) {
+			for (uint16_t start : pages[page]) {
+				const Block& block = blocks.at(start);
+				if (block.start < end && address < block.end) {
+					dirty.push_back(start);
+				}
+			}
+		}
+		if (grown) {
+			for (const auto& entry : blocks) {
+				if (entry.second.outOfRange) {
+					dirty.push_back(entry.first);
+				}
+			}
+		}
+		std::sort(dirty.begin(), dirty.end());
+		dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+
+		/* only a change in the shape of a block can change what is reachable */
+		std::vector<uint16_t> reshaped;
+		std::unordered_map<uint16_t, Block> decoded;
+		for (uint16_t start : dirty) {
+			Block block = Decode(start);
+			Block& old = blocks.at(start);
+			bool same = block.end == old.end && block.targets == old.targets && block.code.size() == old.code.size();
+			for (size_t k = 0; same && k < block.code.size(); k++) {
+				same = block.code[k].address == old.code[k].address;
+			}
+			if (same) {
+				for (size_t k = 0; k < block.code.size(); k++) {
+					const Instruction& was = old.code[k];
+					const Instruction& now = block.code[k];
+					if (was.bin != now.bin || (now.opcode.Length() == 4 && was.ext != now.ext)) {
+						erased.push_back(was);
+						inserted.push_back(now.address);
+					}
+				}
+				old = std::move(block);
+			}
+			else {
+				reshaped.push_back(start);
+				decoded.emplace(start, std::move(block));
+			}
+		}
+		Relink(reshaped, std::move(decoded));
+
+		/*
+		even a patch that keeps the shape of every block can change the values, and with them the targets of JP V0,
+		but one that changed no instruction leaves them as they were
+		*/
+		if (!inserted.empty() || !erased.empty() || grown) {
+			Update();
+		}
+	}
+
+	const Analysis::Block& Analysis::GetBlock(uint16_t start) const {
+		auto it = blocks.find(start);
+		if (it == blocks.end()) {
+			throw std::runtime_error(Formatter() << "No block starts at " << std::hex << start);
+		}
+		return it->second;
+	}
+
+	const std::vector<uint16_t>& Analysis::JumpTargets(uint16_t address) const {
+		static const std::vector<uint16_t> NONE;
+		auto it = jumps.find(address);
+		return it != jumps.end() ? it->second : NONE;
+	}
+
+	const Analysis::Values* Analysis::GetValues(uint16_t address) const {
+		auto it = values.find(address);
+		return it != values.end() ? &it->second : nullptr;
+	}
+
+	void Analysis::Verify() const {
+		Analysis fresh(image.data(), image.size(), base);
+		for (uint16_t root : roots) {
+			fresh.AddRoot(root);
+		}
+		for (uint32_t address = 0; address < 0x10000; address++) {
+			if (IsCode((uint16_t)address) != fresh.IsCode((uint16_t)address)) {
+				throw std::runtime_error(Formatter() << "Reachable code differs from a new analysis at " << std::hex << address);
+			}
+			if (JumpTargets((uint16_t)address) != fresh.JumpTargets((uint16_t)address)) {
+				throw std::runtime_error(Formatter() << "Targets of JP V0 differ from a new analysis at " << std::hex << address);
+			}
+		}
+	}
+
+	bool Analysis::ShouldContinue(const Opcode& prev, const Opcode& opcode) {
+		switch (prev.Type()) {
+			case OpcodeType::SE:
+			case OpcodeType::SNE:
+			case OpcodeType::SKP:
+			case OpcodeType::SKNP:
+				return true;
+			default:
+				break;
+		}
+		switch (opcode.Type()) {
+			case OpcodeType::JP:
+			case OpcodeType::JP_V0:
+			case OpcodeType::RET:
+			case OpcodeType::EXIT:
+				return false;
+			default:
+				return true;
+		}
+	}
+
+	Analysis::Block Analysis::Decode(uint16_t start) const {
+		Statistics::Count(Counter::BLOCKS_DISCOVERED);
+
+		Block block;
+		block.start = start;
+		block.outOfRange = false;
+
+		uint32_t address = start;
+		Opcode prev(0);
+		Opcode opcode(0);
+		do {
+			if (address + 2 > base + image.size()) {
+				block.outOfRange = true;
+				break;
+			}
+
+			Instruction ins;
+			ins.address = (uint16_t)address;
+			ins.bin = ReadWord(address);
+			ins.ext = ReadWord(address + 2);
+
+			prev = opcode;
+			try {
+				opcode = Opcode(ins.bin, ins.ext, true);
+			}
+			catch (const std::runtime_error& err) {
+				ins.error = err.what();
+				opcode = Opcode(0);
+			}
+			ins.opcode = opcode;
+
+			// we want to checkout every place we jump into
+			switch (opcode.Type()) {
+				case OpcodeType::JP:
+				case OpcodeType::CALL: {
+					if (opcode.Operand1().GetType() == OperandType::IMMEDIATE) {
+						block.targets.push_back(opcode.Operand1().AsImmediate());
+					}
+				} break;
+				default:
+					break;
+			}
+
+			block.code.push_back(std::move(ins));
+			address += opcode.Length();
+		} while (ShouldContinue(prev, opcode) && address < 0x10000);
+
+		block.end = address;
+		return block;
+	}
+
+	uint16_t Analysis::ReadWord(uint32_t address) const {
+		uint16_t word = 0;
+		for (uint32_t k = 0; k < 2; k++) {
+			word <<= 8;
+			if (address + k >= base && address + k - base < image.size()) {
+				word |= image[address + k - base];
+			}
+		}
+		return word;
+	}
+
+	std::vector<uint16_t> Analysis::Successors(const Block& block) const {
+		std::vector<uint16_t> successors(block.targets);
+		/* a skip keeps the block going past a JP V0, so it does not have to be the last instruction */
+		for (const Instruction& ins : block.code) {
+			if (ins.opcode.Type() == OpcodeType::JP_V0) {
+				const std::vector<uint16_t>& targets = JumpTargets(ins.address);
+				successors.insert(successors.end(), targets.begin(), targets.end());
+			}
+		}
+		return successors;
+	}
+
+	void Analysis::Insert(Block block) {
+		uint16_t start = block.start;
+		uint32_t last = std::max<uint32_t>(block.end, start + 1) - 1;
+		for (uint32_t page = start >> PAGE_SHIFT; page <= (last >> PAGE_SHIFT) && page < pages.size(); page++) {
+			pages[page].push_back(start);
+		}
+		for (const Instruction& ins : block.code) {
+			visited[ins.address]++;
+			inserted.push_back(ins.address);
+		}
+		std::vector<uint16_t> successors = Successors(block);
+		for (uint16_t target : successors) {
+			preds[target].push_back(start);
+		}
+		edges[start] = std::move(successors);
+		order.push_back(start);
+		blocks[start] = std::move(block);
+	}
+
+	Analysis::Block Analysis::Erase(uint16_t start) {
+		auto it = blocks.find(start);
+		Block block = std::move(it->second);
+		blocks.erase(it);
+
+		uint32_t last = std::max<uint32_t>(block.end, start + 1) - 1;
+		for (uint32_t page = start >> PAGE_SHIFT; page <= (last >> PAGE_SHIFT) && page < pages.size(); page++) {
+			std::vector<uint16_t>& starts = pages[page];
+			starts.erase(std::remove(starts.begin(), starts.end(), start), starts.end());
+		}
+		for (const Instruction& ins : block.code) {
+			visited[ins.address]--;
+		}
+		erased.insert(erased.end(), block.code.begin(), block.code.end());
+		for (uint16_t target : edges.at(start)) {
+			std::vector<uint16_t>& sources = preds.at(target);
+			sources.erase(std::find(sources.begin(), sources.end(), start));
+			if (sources.empty()) {
+				preds.erase(target);
+			}
+		}
+		edges.erase(start);
+		return block;
+	}
+
+	void Analysis::Walk(std::vector<uint16_t> addresses, std::unordered_map<uint16_t, Block> cache) {
+		while (!addresses.empty()) {
+			uint16_t address = addresses.back();
+			addresses.pop_back();
+
+			if (address < base) continue;
+			if (visited[address] || blocks.find(address) != blocks.end()) continue;
+
+			auto it = cache.find(address);
+			if (it == cache.end()) {
+				Statistics::Count(Counter::CACHE_MISSES);
+				Insert(Decode(address));
+			}
+			else {
+				Statistics::Count(Counter::CACHE_HITS);
+				Insert(std::move(it->second));
+				cache.erase(it);
+			}
+			const std::vector<uint16_t>& successors = edges.at(address);
+			addresses.insert(addresses.end(), successors.begin(), successors.end());
+		}
+	}
+
+	void Analysis::Relink(const std::vector<uint16_t>& changed, std::unordered_map<uint16_t, Block> decoded) {
+		/* only the blocks the changed ones lead to can lose their way in, everything else keeps its path from a root */
+		std::unordered_set<uint16_t> region;
+		std::vector<uint16_t> stack(changed);
+		while (!stack.empty()) {
+			uint16_t start = stack.back();
+			stack.pop_back();
+			if (blocks.find(start) == blocks.end() || !region.insert(start).second) {
+				continue;
+			}
+			const std::vector<uint16_t>& successors = edges.at(start);
+			stack.insert(stack.end(), successors.begin(), successors.end());
+		}
+		if (region.empty()) {
+			return;
+		}
+
+		std::vector<uint16_t> released;
+		for (uint16_t start : region) {
+			Block block = Erase(start);
+			released.push_back(start);
+			for (const Instruction& ins : block.code) {
+				released.push_back(ins.address);
+			}
+			/* the unchanged blocks are walked again from memory */
+			decoded.emplace(start, std::move(block));
+		}
+		order.erase(std::remove_if(order.begin(), order.end(), [&](uint16_t start) { return region.count(start) != 0; }), order.end());
+
+		/* walk again from every address of the region that is still a root or a target, whatever is not reached is evicted */
+		std::sort(released.begin(), released.end());
+		released.erase(std::unique(released.begin(), released.end()), released.end());
+		std::vector<uint16_t> addresses;
+		for (auto it = released.rbegin(); it != released.rend(); ++it) {
+			if (preds.find(*it) != preds.end() || std::find(roots.begin(), roots.end(), *it) != roots.end()) {
+				addresses.push_back(*it);
+			}
+		}
+		Walk(std::move(addresses), std::move(decoded));
+	}
+
+	std::vector<uint16_t> Analysis::Unlinked() const {
+		std::vector<uint16_t> changed;
+		for (const auto& entry : blocks) {
+			if (Successors(entry.second) != edges.at(entry.first)) {
+				changed.push_back(entry.first);
+			}
+		}
+		return changed;
+	}
+
+	void Analysis::Update() {
+		/*
+		the targets of JP V0 are resolved again from none, the way a new analysis
+		resolves them, so the result does not depend on the changes that led to it
+		*/
+		if (!jumps.empty()) {
+			jumps.clear();
+			Relink(Unlinked(), {});
+		}
+		/*
+		resolving JP V0 makes more code reachable, which can resolve more of them,
+		targets are only ever added so this always settles
+		*/
+		while (Propagate()) {
+			Relink(Unlinked(), {});
+		}
+		Classify();
+	}
+
+	bool Analysis::Propagate() {
+		std::unordered_map<uint16_t, const Instruction*> code;
+		for (uint16_t start : order) {
+			for (const Instruction& ins : blocks.at(start).code) {
+				code.emplace(ins.address, &ins);
+			}
+		}
+
+		std::vector<uint32_t> calls;
+		for (const auto& entry : code) {
+			if (entry.second->opcode.Type() == OpcodeType::CALL && entry.second->error.empty()) {
+				calls.push_back(entry.first + entry.second->opcode.Length());
+			}
+		}
+
+		/* every value the changed instructions can flow into is found again, the rest is kept */
+		std::unordered_set<uint16_t> dirty;
+		std::vector<uint32_t> stack(inserted.begin(), inserted.end());
+		for (const Instruction& ins : erased) {
+			FlowTargets(ins, calls, stack);
+		}
+		inserted.clear();
+		erased.clear();
+		while (!stack.empty()) {
+			uint32_t address = stack.back();
+			stack.pop_back();
+			auto it = address <= 0xFFFF ? code.find((uint16_t)address) : code.end();
+			if (it != code.end() && dirty.insert((uint16_t)address).second) {
+				FlowTargets(*it->second, calls, stack);
+			}
+		}
+		for (auto it = values.begin(); it != values.end();) {
+			if (dirty.count(it->first) != 0 || code.find(it->first) == code.end()) {
+				it = values.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+
+		std::unordered_map<uint16_t, uint32_t> joins;
+		std::vector<uint16_t> work;
+		auto flow = [&](uint32_t address, const Values& state) {
+			if (address > 0xFFFF || code.find((uint16_t)address) == code.end()) {
+				return;
+			}
+			auto it = values.find((uint16_t)address);
+			if (it == values.end()) {
+				Widen(values.emplace((uint16_t)address, state).first->second);
+				work.push_back((uint16_t)address);
+			}
+			else if (Join(it->second, state, ++joins[(uint16_t)address] > WIDEN_AFTER)) {
+				work.push_back((uint16_t)address);
+			}
+		};
+		auto length = [&](uint32_t address) -> uint32_t {
+			auto it = code.find((uint16_t)address);
+			return address <= 0xFFFF && it != code.end() ? it->second->opcode.Length() : 2;
+		};
+
+		/*
+		calls are not told apart, every return site continues with the values
+		of every RET, which also covers the registers the callee does not touch
+		*/
+		Values returned;
+		uint32_t returns = 0;
+		std::vector<uint32_t> sites;
+
+		/*
+		the kept instructions that flow into the changed ones run again, as does
+		every kept RET and CALL so the return sites see the same values as before
+		*/
+		std::vector<uint32_t> reach;
+		for (const auto& entry : values) {
+			const Instruction& ins = *code.at(entry.first);
+			if (!ins.error.empty()) {
+				continue;
+			}
+			if (ins.opcode.Type() == OpcodeType::CALL) {
+				sites.push_back(entry.first + ins.opcode.Length());
+			}
+			reach.clear();
+			FlowTargets(ins, calls, reach);
+			bool boundary = ins.opcode.Type() == OpcodeType::RET;
+			for (size_t k = 0; !boundary && k < reach.size(); k++) {
+				boundary = reach[k] <= 0xFFFF && dirty.count((uint16_t)reach[k]) != 0;
+			}
+			if (boundary) {
+				work.push_back(entry.first);
+			}
+		}
+		std::sort(sites.begin(), sites.end());
+		sites.erase(std::unique(sites.begin(), sites.end()), sites.end());
+
+		/* the machine starts with every register cleared, other roots can be entered with anything */
+		for (uint16_t root : roots) {
+			if (dirty.count(root) == 0) {
+				continue;
+			}
+			Values state;
+			for (ValueSet& v : state.v) {
+				v = root == base ? ValueSet::Of(0) : ValueSet::All();
+			}
+			state.i = root == base ? AddressSet::Of(0) : AddressSet::All();
+			flow(root, state);
+		}
+
+		while (!work.empty()) {
+			uint16_t address = work.back();
+			work.pop_back();
+
+			const Instruction& ins = *code.at(address);
+			const Opcode& opcode = ins.opcode;
+			if (!ins.error.empty()) {
+				continue;
+			}
+			Values state = values.at(address);
+			uint32_t next = address + opcode.Length();
+
+			switch (opcode.Type()) {
+				case OpcodeType::JP: flow(opcode.Operand1().AsImmediate(), state); break;
+				case OpcodeType::JP_V0: {
+					/*
+					either way of taking the offset narrows its own register,
+					the limit only applies to finding new code, the known code can still be jumped into
+					*/
+					uint16_t nnn = opcode.Operand1().AsImmediate();
+					auto jump = [&](int r) {
+						state.v[r].ForEach([&](uint8_t offset) {
+							Values taken = state;
+							taken.v[r] = ValueSet::Of(offset);
+							flow(nnn + offset, taken);
+						});
+					};
+					jump(0);
+					if (JumpRegister(opcode) != 0) {
+						jump(JumpRegister(opcode));
+					}
+				} break;
+				case OpcodeType::CALL: {
+					if (std::find(sites.begin(), sites.end(), next) == sites.end()) {
+						sites.push_back(next);
+					}
+					flow(opcode.Operand1().AsImmediate(), state);
+					if (returns > 0) {
+						flow(next, returned);
+					}
+				} break;
+				case OpcodeType::RET: {
+					if (Join(returned, state, ++returns > WIDEN_AFTER)) {
+						for (uint32_t site : sites) {
+							flow(site, returned);
+						}
+					}
+				} break;
+				case OpcodeType::EXIT: break;
+				case OpcodeType::SE:
+				case OpcodeType::SNE:
+				case OpcodeType::SKP:
+				case OpcodeType::SKNP: {
+					Values skipped = state;
+					Values kept = state;
+					if ((opcode.Type() == OpcodeType::SE || opcode.Type() == OpcodeType::SNE) && opcode.Operand2().GetType() == OperandType::IMMEDIATE) {
+						int x = (int)opcode.Operand1().AsRegister();
+						uint8_t imm = (uint8_t)opcode.Operand2().AsImmediate();
+						Values& equal = opcode.Type() == OpcodeType::SE ? skipped : kept;
+						Values& unequal = opcode.Type() == OpcodeType::SE ? kept : skipped;
+						equal.v[x] = state.v[x].Contains(imm) ? ValueSet::Of(imm) : ValueSet();
+						unequal.v[x].Erase(imm);
+					}
+					/* a register left without values means that path can never be taken */
+					if (IsFeasible(kept)) {
+						flow(next, kept);
+					}
+					if (IsFeasible(skipped)) {
+						flow(next + length(next), skipped);
+					}
+				} break;
+				default: {
+					Transfer(opcode, state);
+					flow(next, state);
+				} break;
+			}
+		}
+
+		std::unordered_map<uint16_t, std::vector<uint16_t>> resolved(jumps);
+		for (const auto& entry : code) {
+			uint16_t address = entry.first;
+			const Instruction& ins = *entry.second;
+			const Opcode& opcode = ins.opcode;
+			auto state = values.find(address);
+			if (opcode.Type() != OpcodeType::JP_V0 || !ins.error.empty() || state == values.end()) {
+				continue;
+			}
+			const ValueSet offsets = JumpOffsets(opcode, state->second);
+			if (offsets.IsEmpty() || offsets.Count() > MAX_JUMP_TARGETS) {
+				continue;
+			}
+			std::vector<uint16_t> targets = resolved[address];
+			offsets.ForEach([&](uint8_t offset) {
+				uint32_t target = opcode.Operand1().AsImmediate() + offset;
+				if (target >= base && target < base + image.size() && std::find(targets.begin(), targets.end(), target) == targets.end()) {
+					targets.push_back((uint16_t)target);
+				}
+			});
+			std::sort(targets.begin(), targets.end());
+			if (targets.empty()) {
+				resolved.erase(address);
+			}
+			else {
+				resolved[address] = std::move(targets);
+			}
+		}
+
+		bool changed = resolved != jumps;
+		jumps = std::move(resolved);
+		return changed;
+	}
+
+	void Analysis::Classify() {
+		std::fill(data.begin(), data.end(), 0);
+		regions.clear();
+
+		std::vector<uint8_t> covered(0x10000, 0);
+		for (uint16_t start : order) {
+			const Block& block = blocks.at(start);
+			for (uint32_t address = block.start; address < block.end && address < covered.size(); address++) {
+				covered[address] = 1;
+			}
+		}
+
+		uint32_t end = base + (uint32_t)image.size();
+		for (uint16_t start : order) {
+			for (const Instruction& ins : blocks.at(start).code) {
+				auto state = values.find(ins.address);
+				uint32_t length = AccessLength(ins.opcode);
+				if (state == values.end() || length == 0 || !ins.error.empty()) {
+					continue;
+				}
+				/* a wide interval is more likely a loop walking memory than a known table */
+				state->second.i.ForEach([&](uint16_t first, uint16_t last) {
+					if ((uint32_t)last - first + 1 > MAX_DATA_SPAN) {
+						return;
+					}
+					for (uint32_t address = std::max<uint32_t>(first, base); address < (uint32_t)last + length && address < end; address++) {
+						if (!covered[address]) {
+							data[address] = 1;
+						}
+					}
+				});
+			}
+		}
+
+		for (uint32_t address = base; address < end; address++) {
+			if (!data[address]) {
+				continue;
+			}
+			if (!regions.empty() && regions.back().end == address) {
+				regions.back().end++;
+			}
+			else {
+				regions.push_back({ (uint16_t)address, address + 1 });
+			}
+		}
+	}
+
+}
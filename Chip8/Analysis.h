@@ -0,0 +1,200 @@
+#pragma once
+
+#include "Opcode.h"
+#include "ValueSet.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace chip8 {
+
+	/*
+	Recovers the code of a rom by recursive traversal from a set of roots
+
+	the decoded blocks are kept in memory, so the image can be patched and
+	only the blocks covering the patched bytes are decoded again, the block
+	graph is only walked again from the blocks that changed shape, and the
+	blocks that can no longer be reached are dropped
+
+	after every traversal the values of V0-VF and I are propagated over the
+	reachable code, which resolves the targets of JP V0 into more roots and
+	finds the bytes I points at when sprites, BCD and registers are read
+	or written, the values are only ever an over-approximation
+
+	the values are only propagated again from the instructions that were
+	decoded or dropped since, everything they cannot flow into is kept
+	*/
+	class Analysis {
+	public:
+		/* the default root and load address of roms */
+		static const uint16_t START_ADDRESS = 0x200;
+
+		struct Instruction {
+			uint16_t address;
+			uint16_t bin;
+			/* the word after the instruction, only meaningful if the opcode is 4 bytes */
+			uint16_t ext;
+			Opcode opcode;
+			/* the decoder's message if the instruction is invalid, empty otherwise */
+			std::string error;
+		};
+
+		struct Block {
+			uint16_t start;
+			/* the address right after the last decoded byte */
+			uint32_t end;
+			/* true if the block runs past the end of the image */
+			bool outOfRange;
+			std::vector<Instruction> code;
+			/* the jump and call targets, in the order they appear */
+			std::vector<uint16_t> targets;
+		};
+
+		/*
+		The values V0-VF and I may hold when an instruction is run
+		*/
+		struct Values {
+			ValueSet v[16];
+			AddressSet i;
+		};
+
+		/* a run of bytes the code reads or writes through I, [start, end) */
+		struct Region {
+			uint16_t start;
+			uint32_t end;
+		};
+
+		/* JP V0 with more possible targets than this is left unresolved */
+		static const uint32_t MAX_JUMP_TARGETS = 64;
+		/* an interval of I wider than this does not mark its bytes as data */
+		static const uint32_t MAX_DATA_SPAN = 256;
+
+		/*
+		Will load the given rom at base and traverse it from base
+		*/
+		Analysis(const uint8_t* rom, size_t size, uint16_t base = START_ADDRESS);
+
+		/*
+		Will add another address to traverse from
+		*/
+		void AddRoot(uint16_t address);
+
+		/*
+		Will add several addresses to traverse from and update the analysis once,
+		an address the ones before it already reached is skipped
+
+		returns the amount of roots that were added
+		*/
+		size_t AddRoots(const std::vector<uint16_t>& addresses);
+
+		/*
+		Will overwrite the given range of the image, growing it if needed,
+		and update the analysis
+
+		will throw an exception if the range starts before the base
+		*/
+		void Patch(uint32_t address, const uint8_t* bytes, size_t size);
+
+		/*
+		Return the start of every reachable block, in traversal order
+		*/
+		inline const std::vector<uint16_t>& Order() const { return order; }
+
+		/*
+		Return a decoded block, only valid until the next change to the analysis
+
+		will throw an exception if no block starts at the given address
+		*/
+		const Block& GetBlock(uint16_t start) const;
+
+		/*
+		Return if an instruction of the reachable code starts at the given address
+		*/
+		inline bool IsCode(uint16_t address) const { return visited[address] != 0; }
+
+		/*
+		Return if the byte at the given address is read or written through I,
+		and is not part of an instruction of the reachable code
+		*/
+		inline bool IsData(uint16_t address) const { return data[address] != 0; }
+
+		/*
+		Return every run of data bytes, in ascending order
+		*/
+		inline const std::vector<Region>& DataRegions() const { return regions; }
+
+		/*
+		Return the resolved targets of the JP V0 at the given address in ascending order,
+		empty if the address does not hold a reachable JP V0 or it could not be resolved
+		*/
+		const std::vector<uint16_t>& JumpTargets(uint16_t address) const;
+
+		/*
+		Return the values the instruction at the given address runs with,
+		null if no reachable instruction starts there
+		*/
+		const Values* GetValues(uint16_t address) const;
+
+		/*
+		Will build a new analysis of the image from the same roots and compare
+		the reachable code and the targets of every JP V0 with this one,
+		meant to check that patching keeps the analysis exact
+
+		will throw an exception naming the first address that differs
+		*/
+		void Verify() const;
+
+		inline const std::vector<uint8_t>& Image() const { return image; }
+		inline uint16_t Base() const { return base; }
+		inline const std::vector<uint16_t>& Roots() const { return roots; }
+
+		/*
+		Return if the given instruction ends the linear run of code,
+		prev is the instruction before it
+		*/
+		static bool ShouldContinue(const Opcode& prev, const Opcode& opcode);
+
+	private:
+		static const int PAGE_SHIFT = 8;
+
+		Block Decode(uint16_t start) const;
+		uint16_t ReadWord(uint32_t address) const;
+		std::vector<uint16_t> Successors(const Block& block) const;
+		void Insert(Block block);
+		Block Erase(uint16_t start);
+		void Walk(std::vector<uint16_t> addresses, std::unordered_map<uint16_t, Block> cache);
+		void Relink(const std::vector<uint16_t>& changed, std::unordered_map<uint16_t, Block> decoded);
+		std::vector<uint16_t> Unlinked() const;
+		void Update();
+		bool Propagate();
+		void Classify();
+
+		std::vector<uint8_t> image;
+		uint16_t base;
+		std::vector<uint16_t> roots;
+		std::vector<uint16_t> order;
+
+		/* every reachable block */
+		std::unordered_map<uint16_t, Block> blocks;
+		/* the start of every block covering each page of the address space */
+		std::vector<std::vector<uint16_t>> pages;
+		/* the amount of blocks with an instruction at each address */
+		std::vector<uint16_t> visited;
+		/* the successors every block was linked with, and the blocks linked to every address */
+		std::unordered_map<uint16_t, std::vector<uint16_t>> edges;
+		std::unordered_map<uint16_t, std::vector<uint16_t>> preds;
+		/* the instructions decoded and dropped since the values were propagated */
+		std::vector<uint16_t> inserted;
+		std::vector<Instruction> erased;
+
+		std::unordered_map<uint16_t, Values> values;
+		std::unordered_map<uint16_t, std::vector<uint16_t>> jumps;
+		/* one flag per address, see IsData */
+		std::vector<uint8_t> data;
+		std::vector<Region> regions;
+
+	};
+
+}
@@ -0,0 +1,193 @@
+#include "Audio.h"
+
+#include "Formatter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define CHIP8_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace chip8 {
+
+	/* a 500hz square wave at the default pitch */
+	static const uint8_t BEEPER[16] = {
+		0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0,
+		0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0,
+	};
+
+	static const int FRAMES_PER_SECOND = 60;
+	static const int PHASE_SHIFT = 25;
+
+	static inline void Fill(int16_t* out, size_t count, int16_t value) {
+#ifdef CHIP8_SSE2
+		__m128i v = _mm_set1_epi16(value);
+		for (; count >= 8; count -= 8, out += 8) {
+			_mm_storeu_si128((__m128i*)out, v);
+		}
+#endif
+		std::fill_n(out, count, value);
+	}
+
+	Audio::Audio(uint32_t sampleRate, int16_t volume)
+		: sampleRate(sampleRate)
+		, volume(volume)
+		, phase(0)
+		, carry(0)
+		, samples(sampleRate / FRAMES_PER_SECOND + 1)
+	{
+		if (sampleRate < FRAMES_PER_SECOND) {
+			throw std::runtime_error(Formatter() << "Invalid sample rate " << sampleRate);
+		}
+	}
+
+	size_t Audio::RenderFrame(const Machine& machine) {
+		uint32_t total = sampleRate + carry;
+		size_t count = total / FRAMES_PER_SECOND;
+		carry = total % FRAMES_PER_SECOND;
+
+		if (machine.GetRegister(Register::ST) == 0) {
+			Fill(samples.data(), count, 0);
+			return count;
+		}
+
+		const uint8_t* pattern = BEEPER;
+		uint8_t pitch = 64;
+		if (machine.GetVariant() == Variant::XOCHIP) {
+			const uint8_t* loaded = machine.AudioPattern();
+			/* roms that never load a pattern still expect to beep */
+			if (std::any_of(loaded, loaded + 16, [](uint8_t b) { return b != 0; })) {
+				pattern = loaded;
+				pitch = machine.AudioPitch();
+			}
+		}
+		Render(pattern, pitch, samples.data(), count);
+		return count;
+	}
+
+	void Audio::Render(const uint8_t* pattern, uint8_t pitch, int16_t* out, size_t count) {
+		double rate = 4000.0 * std::pow(2.0, (pitch - 64) / 48.0);
+		/* at low sample rates and high pitches a sample covers more than the whole pattern, which does not fit the phase */
+		uint64_t exact = (uint64_t)(rate / sampleRate * (1 << PHASE_SHIFT));
+		uint32_t step = (uint32_t)std::min<uint64_t>(std::max<uint64_t>(exact, 1), UINT32_MAX);
+
+		/* a bit of the pattern covers several samples, so fill whole runs at once */
+		size_t n = 0;
+		while (n < count) {
+			uint32_t bit = phase >> PHASE_SHIFT;
+			bool set = (pattern[bit >> 3] >> (7 - (bit & 7))) & 1;
+			uint64_t left = ((uint64_t)(bit + 1) << PHASE_SHIFT) - phase;
+			size_t run = (size_t)std::min<uint64_t>((left + step - 1) / step, count - n);
+			Fill(out + n, run, set ? volume : -volume);
+			phase += (uint32_t)(run * step);
+			n += run;
+		}
+	}
+
+	SampleRing::SampleRing(size_t capacity)
+		: head(0)
+		, tail(0)
+	{
+		size_t size = 1;
+		while (size < capacity) {
+			size <<= 1;
+		}
+		buffer.resize(size);
+		mask = size - 1;
+	}
+
+	size_t SampleRing::Push(const int16_t* samples, size_t count) {
+		size_t h = head.load(std::memory_order_relaxed);
+		size_t t = tail.load(std::memory_order_acquire);
+		count = std::min(count, buffer.size() - (h - t));
+
+		size_t first = std::min(count, buffer.size() - (h & mask));
+		memcpy(&buffer[h & mask], samples, first * sizeof(int16_t));
+		memcpy(&buffer[0], samples + first, (count - first) * sizeof(int16_t));
+		head.store(h + count, std::memory_order_release);
+		return count;
+	}
+
+	size_t SampleRing::Pop(int16_t* samples, size_t count) {
+		size_t t = tail.load(std::memory_order_relaxed);
+		size_t h = head.load(std::memory_order_acquire);
+		count = std::min(count, h - t);
+
+		size_t first = std::min(count, buffer.size() - (t & mask));
+		memcpy(samples, &buffer[t & mask], first * sizeof(int16_t));
+		memcpy(samples + first, &buffer[0], (count - first) * sizeof(int16_t));
+		tail.store(t + count, std::memory_order_release);
+		return count;
+	}
+
+	WavWriter::WavWriter(const std::string& path, uint32_t sampleRate)
+		: file(path, std::ios::binary)
+		, sampleRate(sampleRate)
+		, count(0)
+	{
+		if (!file) {
+			throw std::runtime_error(Formatter() << "Could not create " << path);
+		}
+		WriteHeader();
+	}
+
+	WavWriter::~WavWriter() {
+		Close();
+	}
+
+	void WavWriter::Write(const int16_t* samples, size_t count) {
+		/* WAV is little endian */
+		uint8_t bytes[512];
+		while (count > 0) {
+			size_t chunk = std::min(count, sizeof(bytes) / 2);
+			for (size_t k = 0; k < chunk; k++) {
+				bytes[k * 2] = (uint8_t)samples[k];
+				bytes[k * 2 + 1] = (uint8_t)((uint16_t)samples[k] >> 8);
+			}
+			file.write((const char*)bytes, chunk * 2);
+			this->count += (uint32_t)chunk;
+			samples += chunk;
+			count -= chunk;
+		}
+	}
+
+	void WavWriter::Close() {
+		if (file.is_open()) {
+			file.seekp(0);
+			WriteHeader();
+			file.close();
+		}
+	}
+
+	void WavWriter::WriteHeader() {
+		uint32_t dataSize = count * 2;
+		uint32_t fields[] = {
+			0x46464952, /* RIFF */
+			36 + dataSize,
+			0x45564157, /* WAVE */
+			0x20746D66, /* fmt */
+			16,
+			/* PCM, mono */
+			1 | (1 << 16),
+			sampleRate,
+			sampleRate * 2,
+			/* 2 bytes per frame, 16 bits per sample */
+			2 | (16 << 16),
+			0x61746164, /* data */
+			dataSize,
+		};
+		uint8_t bytes[sizeof(fields)];
+		for (size_t k = 0; k < sizeof(fields) / 4; k++) {
+			bytes[k * 4 + 0] = (uint8_t)fields[k];
+			bytes[k * 4 + 1] = (uint8_t)(fields[k] >> 8);
+			bytes[k * 4 + 2] = (uint8_t)(fields[k] >> 16);
+			bytes[k * 4 + 3] = (uint8_t)(fields[k] >> 24);
+		}
+		file.write((const char*)bytes, sizeof(bytes));
+	}
+
+}
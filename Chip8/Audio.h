@@ -0,0 +1,118 @@
+#pragma once
+
+#include "Machine.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace chip8 {
+
+	/*
+	Renders the sound of a machine into 16 bit mono PCM, one 60hz frame at a time
+
+	while ST is non zero the 128 bit XO-CHIP pattern is played at
+	4000 * 2 ^ ((pitch - 64) / 48) bits per second, machines without a
+	pattern play a 500hz square wave instead
+	*/
+	class Audio {
+	public:
+		static const uint32_t DEFAULT_SAMPLE_RATE = 48000;
+		static const int16_t DEFAULT_VOLUME = 8192;
+
+		Audio(uint32_t sampleRate = DEFAULT_SAMPLE_RATE, int16_t volume = DEFAULT_VOLUME);
+
+		/*
+		Will render the sound of a single frame, should be called once
+		every frame before the timers tick
+
+		returns the amount of samples, which are valid until the next call
+		*/
+		size_t RenderFrame(const Machine& machine);
+
+		inline const int16_t* Samples() const { return samples.data(); }
+		inline uint32_t SampleRate() const { return sampleRate; }
+
+	private:
+		void Render(const uint8_t* pattern, uint8_t pitch, int16_t* out, size_t count);
+
+		uint32_t sampleRate;
+		int16_t volume;
+		/* the position in the pattern, the whole 32 bits span the 128 bits of the pattern */
+		uint32_t phase;
+		/* the fraction of a sample carried over between frames, in 1/60ths */
+		uint32_t carry;
+		std::vector<int16_t> samples;
+
+	};
+
+	/*
+	A single producer, single consumer queue of samples, the emulation
+	pushes and the audio device pops without any locking
+	*/
+	class SampleRing {
+	public:
+		/*
+		The capacity is rounded up to a power of two
+		*/
+		SampleRing(size_t capacity);
+		SampleRing(const SampleRing&) = delete;
+		SampleRing& operator=(const SampleRing&) = delete;
+
+		/*
+		Will queue as many of the samples as fit, returns the amount queued
+		*/
+		size_t Push(const int16_t* samples, size_t count);
+
+		/*
+		Will take up to count samples, returns the amount taken
+		*/
+		size_t Pop(int16_t* samples, size_t count);
+
+		inline size_t Available() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+		inline size_t Capacity() const { return buffer.size(); }
+
+	private:
+		std::vector<int16_t> buffer;
+		size_t mask;
+		/* only written by the producer */
+		std::atomic<size_t> head;
+		/* only written by the consumer */
+		std::atomic<size_t> tail;
+
+	};
+
+	/*
+	Streams 16 bit mono PCM into a WAV file, the sizes in the header
+	are filled in when the file is closed
+	*/
+	class WavWriter {
+	public:
+		/*
+		will throw an exception if the file can not be created
+		*/
+		WavWriter(const std::string& path, uint32_t sampleRate);
+		WavWriter(const WavWriter&) = delete;
+		WavWriter& operator=(const WavWriter&) = delete;
+		~WavWriter();
+
+		void Write(const int16_t* samples, size_t count);
+
+		/*
+		Will complete the header and close the file, called by the destructor
+		*/
+		void Close();
+
+	private:
+		void WriteHeader();
+
+		std::ofstream file;
+		uint32_t sampleRate;
+		uint32_t count;
+
+	};
+
+}
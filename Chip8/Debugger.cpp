@@ -0,0 +1,146 @@
+#include "Debugger.h"
+
+#include "Formatter.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace chip8 {
+
+	Debugger::Debugger(Interpreter& interpreter)
+		: interpreter(interpreter)
+		, breakpoints()
+		, watchpoints()
+		, reason(StopReason::NONE)
+		, stopAddress(0)
+		, resumeAddress(-1)
+	{
+		if (interpreter.debugger != nullptr) {
+			throw std::runtime_error("A debugger is already attached to the interpreter");
+		}
+		interpreter.debugger = this;
+	}
+
+	Debugger::~Debugger() {
+		for (const auto& entry : breakpoints) {
+			interpreter.SetTrap(entry.first, false);
+		}
+		interpreter.ClearWatches();
+		interpreter.debugger = nullptr;
+	}
+
+	void Debugger::AddBreakpoint(uint16_t address) {
+		Breakpoint breakpoint = { false, Register::V0, Comparison::EQUAL, 0 };
+		breakpoints[address] = breakpoint;
+		interpreter.SetTrap(address, true);
+	}
+
+	void Debugger::AddBreakpoint(uint16_t address, Register reg, Comparison comparison, uint16_t value) {
+		if (reg >= Register::COUNT) {
+			throw std::runtime_error(Formatter() << "Attempted to break on invalid register " << (int)reg);
+		}
+		Breakpoint breakpoint = { true, reg, comparison, value };
+		breakpoints[address] = breakpoint;
+		interpreter.SetTrap(address, true);
+	}
+
+	void Debugger::RemoveBreakpoint(uint16_t address) {
+		if (breakpoints.erase(address) != 0) {
+			interpreter.SetTrap(address, false);
+		}
+	}
+
+	void Debugger::AddWatchpoint(uint32_t address, uint32_t size) {
+		if (size == 0) {
+			return;
+		}
+		Watchpoint watchpoint = { address, size };
+		watchpoints.push_back(watchpoint);
+		interpreter.SetWatch(address, size);
+	}
+
+	void Debugger::RemoveWatchpoint(uint32_t address, uint32_t size) {
+		auto it = std::remove_if(watchpoints.begin(), watchpoints.end(), [&](const Watchpoint& w) {
+			return w.address == address && w.size == size;
+		});
+		watchpoints.erase(it, watchpoints.end());
+
+		interpreter.ClearWatches();
+		for (const Watchpoint& w : watchpoints) {
+			interpreter.SetWatch(w.address, w.size);
+		}
+	}
+
+	uint64_t Debugger::Continue(uint64_t cycles) {
+		return Resume(cycles);
+	}
+
+	uint64_t Debugger::Step() {
+		return Resume(1);
+	}
+
+	uint64_t Debugger::Resume(uint64_t cycles) {
+		Machine& m = interpreter.GetMachine();
+		if (m.GetState() == MachineState::BREAK) {
+			m.state = MachineState::RUNNING;
+		}
+
+		/* only the breakpoint that stopped the machine is passed, one that was never hit still stops it */
+		resumeAddress = (reason == StopReason::BREAKPOINT && stopAddress == m.pc) ? m.pc : -1;
+		reason = StopReason::NONE;
+		uint64_t executed = interpreter.Run(cycles);
+		resumeAddress = -1;
+
+		if (reason == StopReason::NONE) {
+			switch (m.GetState()) {
+				case MachineState::HALTED: reason = StopReason::HALTED; break;
+				case MachineState::WAITING_KEY: reason = StopReason::WAITING_KEY; break;
+				default: break;
+			}
+		}
+		return executed;
+	}
+
+	bool Debugger::OnBreakpoint(uint16_t address) {
+		if (resumeAddress == address) {
+			resumeAddress = -1;
+			return false;
+		}
+
+		auto it = breakpoints.find(address);
+		if (it == breakpoints.end()) {
+			return false;
+		}
+
+		const Breakpoint& breakpoint = it->second;
+		if (breakpoint.conditional) {
+			uint16_t value = interpreter.GetMachine().GetRegister(breakpoint.reg);
+			bool hit = false;
+			switch (breakpoint.comparison) {
+				case Comparison::EQUAL: hit = value == breakpoint.value; break;
+				case Comparison::NOT_EQUAL: hit = value != breakpoint.value; break;
+				case Comparison::LESS: hit = value < breakpoint.value; break;
+				case Comparison::GREATER: hit = value > breakpoint.value; break;
+			}
+			if (!hit) {
+				return false;
+			}
+		}
+
+		reason = StopReason::BREAKPOINT;
+		stopAddress = address;
+		return true;
+	}
+
+	bool Debugger::OnWrite(uint16_t address) {
+		for (const Watchpoint& w : watchpoints) {
+			if (address >= w.address && address < w.address + w.size) {
+				reason = StopReason::WATCHPOINT;
+				stopAddress = address;
+				return true;
+			}
+		}
+		return false;
+	}
+
+}
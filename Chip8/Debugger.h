@@ -0,0 +1,117 @@
+#pragma once
+
+#include "Interpreter.h"
+#include "Register.h"
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+namespace chip8 {
+
+	enum class Comparison {
+		EQUAL,
+		NOT_EQUAL,
+		LESS,
+		GREATER,
+	};
+
+	enum class StopReason {
+		NONE,
+		BREAKPOINT,
+		WATCHPOINT,
+		HALTED,
+		WAITING_KEY,
+	};
+
+	/*
+	Breakpoints, watchpoints and single stepping on top of an interpreter
+
+	breakpoints split the interpreter's cached blocks so they always start a
+	block, and watchpoints reuse the interpreter's per page write tracking,
+	so code outside of a watched page or breakpoint runs at full speed
+	*/
+	class Debugger {
+	public:
+		/*
+		Will attach to the interpreter, only a single debugger can be attached
+		*/
+		Debugger(Interpreter& interpreter);
+		Debugger(const Debugger&) = delete;
+		Debugger& operator=(const Debugger&) = delete;
+		~Debugger();
+
+		/*
+		Will break when the given address is about to run
+		*/
+		void AddBreakpoint(uint16_t address);
+
+		/*
+		Will break when the given address is about to run and the
+		register compares to value, the register can be any register
+		*/
+		void AddBreakpoint(uint16_t address, Register reg, Comparison comparison, uint16_t value);
+
+		void RemoveBreakpoint(uint16_t address);
+
+		/*
+		Will break right after an instruction wrote to the given range
+		*/
+		void AddWatchpoint(uint32_t address, uint32_t size);
+		void RemoveWatchpoint(uint32_t address, uint32_t size);
+
+		/*
+		Will run up to the given amount of instructions, stopping at
+		breakpoints and watchpoints, a breakpoint at the current PC is
+		only passed if the last stop was on that breakpoint
+
+		returns the amount of instructions that were executed
+		*/
+		uint64_t Continue(uint64_t cycles);
+
+		/*
+		Will run a single instruction, passing a breakpoint at the current PC
+		only if the last stop was on that breakpoint
+		*/
+		uint64_t Step();
+
+		inline StopReason GetStopReason() const { return reason; }
+
+		/*
+		Return the breakpoint that was hit, or the address that was written for a watchpoint
+		*/
+		inline uint16_t GetStopAddress() const { return stopAddress; }
+
+	private:
+		friend class Interpreter;
+
+		struct Breakpoint {
+			bool conditional;
+			Register reg;
+			Comparison comparison;
+			uint16_t value;
+		};
+
+		struct Watchpoint {
+			uint32_t address;
+			uint32_t size;
+		};
+
+		/* called by the interpreter, return true to stop the machine */
+		bool OnBreakpoint(uint16_t address);
+		bool OnWrite(uint16_t address);
+
+		uint64_t Resume(uint64_t cycles);
+
+		Interpreter& interpreter;
+		std::unordered_map<uint16_t, Breakpoint> breakpoints;
+		std::vector<Watchpoint> watchpoints;
+
+		StopReason reason;
+		uint16_t stopAddress;
+		/* the breakpoint the machine last stopped on and is resuming from, -1 if none */
+		int32_t resumeAddress;
+
+	};
+
+}
@@ -0,0 +1,146 @@
+#include "Explorer.h"
+
+#include "Interpreter.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+namespace chip8 {
+
+	static inline uint32_t NextRandom(uint32_t& state) {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	Explorer::Explorer(const uint8_t* rom, size_t size, Variant variant)
+		: Explorer(rom, size, variant, DefaultQuirks(variant))
+	{
+	}
+
+	Explorer::Explorer(const uint8_t* rom, size_t size, Variant variant, uint32_t quirks)
+		: image(std::make_shared<MemoryImage>(variant, rom, size))
+		, variant(variant)
+		, quirks(quirks)
+		, lock()
+		, coverage(0x10000, 0)
+		, corpus()
+		, frames(0)
+		, instructions(0)
+	{
+	}
+
+	void Explorer::Run(uint32_t instances, uint32_t frames, uint32_t threads, uint32_t cyclesPerFrame) {
+		if (threads == 0) {
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		}
+		threads = std::min(threads, std::max(1u, instances));
+
+		std::vector<std::thread> workers;
+		uint32_t first = 0;
+		for (uint32_t t = 0; t < threads; t++) {
+			uint32_t count = instances / threads + (t < instances % threads ? 1 : 0);
+			workers.emplace_back(&Explorer::Worker, this, first, count, frames, cyclesPerFrame);
+			first += count;
+		}
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+	}
+
+	size_t Explorer::Feed(Analysis& analysis) const {
+		std::vector<uint16_t> found;
+		for (uint32_t address = analysis.Base(); address < coverage.size(); address++) {
+			if (coverage[address] && !analysis.IsCode((uint16_t)address)) {
+				found.push_back((uint16_t)address);
+			}
+		}
+		/* the analysis skips the addresses that the roots before them reach */
+		return analysis.AddRoots(found);
+	}
+
+	Explorer::Input Explorer::MakeInput(uint32_t& seed, uint32_t frames) {
+		Input input;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			if (!corpus.empty() && (NextRandom(seed) & 1)) {
+				input = corpus[NextRandom(seed) % corpus.size()];
+			}
+		}
+
+		if (input.empty()) {
+			/* hold a random key for a random amount of frames, with gaps in between */
+			input.resize(frames, 0);
+			uint32_t frame = 0;
+			while (frame < frames) {
+				uint32_t length = 1 + NextRandom(seed) % 30;
+				uint16_t keys = (NextRandom(seed) % 3 == 0) ? 0 : (uint16_t)(1 << (NextRandom(seed) % 16));
+				for (uint32_t k = 0; k < length && frame < frames; k++, frame++) {
+					input[frame] = keys;
+				}
+			}
+		}
+		else {
+			input.resize(frames, 0);
+			uint32_t mutations = 1 + NextRandom(seed) % 8;
+			for (uint32_t k = 0; k < mutations; k++) {
+				uint32_t start = NextRandom(seed) % frames;
+				uint32_t length = 1 + NextRandom(seed) % 30;
+				uint16_t flip = (uint16_t)(1 << (NextRandom(seed) % 16));
+				for (uint32_t frame = start; frame < start + length && frame < frames; frame++) {
+					input[frame] ^= flip;
+				}
+			}
+		}
+		return input;
+	}
+
+	void Explorer::Worker(uint32_t first, uint32_t count, uint32_t frames, uint32_t cyclesPerFrame) {
+		Machine machine(image, quirks);
+		Interpreter interpreter(machine);
+		std::vector<uint8_t> local(machine.MemorySize(), 0);
+		interpreter.SetCoverage(local.data());
+
+		for (uint32_t instance = first; instance < first + count; instance++) {
+			uint32_t seed = 0x9E3779B9u * (instance + 1);
+			Input input = MakeInput(seed, frames);
+
+			/* the same image every time, so the decoded blocks are kept across instances */
+			std::fill(local.begin(), local.end(), 0);
+			interpreter.Load(image);
+			machine.Seed(NextRandom(seed));
+
+			uint64_t executed = 0;
+			uint32_t frame = 0;
+			try {
+				for (; frame < frames && machine.GetState() != MachineState::HALTED; frame++) {
+					for (uint8_t key = 0; key < 16; key++) {
+						machine.SetKey(key, (input[frame] >> key) & 1);
+					}
+					executed += interpreter.Run(cyclesPerFrame);
+					machine.TickTimers();
+				}
+			}
+			catch (const std::runtime_error&) {
+				/* invalid opcodes and stack errors just end the instance */
+			}
+
+			std::lock_guard<std::mutex> guard(lock);
+			bool found = false;
+			for (size_t address = 0; address < local.size(); address++) {
+				if (local[address] && !coverage[address]) {
+					coverage[address] = 1;
+					found = true;
+				}
+			}
+			if (found) {
+				corpus.push_back(std::move(input));
+			}
+			this->frames += frame;
+			this->instructions += executed;
+		}
+	}
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Machine.h"
+#include "Analysis.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace chip8 {
+
+	/*
+	Finds code that static traversal can not see (computed jumps, code
+	only reached after a skip) by running many instances of a rom with
+	random keypad input in parallel and recording every executed address
+
+	instances either get fresh random input, or a mutation of an input
+	that found new code before
+	*/
+	class Explorer {
+	public:
+		Explorer(const uint8_t* rom, size_t size, Variant variant = Variant::XOCHIP);
+		Explorer(const uint8_t* rom, size_t size, Variant variant, uint32_t quirks);
+
+		/*
+		Will run the given amount of instances for the given amount of frames each,
+		spread over threads (0 uses every core), the coverage adds up across calls
+		*/
+		void Run(uint32_t instances, uint32_t frames, uint32_t threads = 0, uint32_t cyclesPerFrame = 15);
+
+		/*
+		Will add every executed address the analysis does not reach as a root
+
+		returns the amount of roots that were added
+		*/
+		size_t Feed(Analysis& analysis) const;
+
+		/*
+		One flag per address, set if an instruction there was executed
+		*/
+		inline const std::vector<uint8_t>& Coverage() const { return coverage; }
+
+		inline uint64_t Frames() const { return frames; }
+		inline uint64_t Instructions() const { return instructions; }
+
+	private:
+		/* the keys held down in every frame */
+		typedef std::vector<uint16_t> Input;
+
+		void Worker(uint32_t first, uint32_t count, uint32_t frames, uint32_t cyclesPerFrame);
+		Input MakeInput(uint32_t& seed, uint32_t frames);
+
+		/* every instance shares the rom and only copies the pages it writes to */
+		std::shared_ptr<const MemoryImage> image;
+		Variant variant;
+		uint32_t quirks;
+
+		/* everything below is shared by the workers and guarded by the lock */
+		std::mutex lock;
+		std::vector<uint8_t> coverage;
+		std::vector<Input> corpus;
+		uint64_t frames;
+		uint64_t instructions;
+
+	};
+
+}
@@ -0,0 +1,259 @@
+#include "Format.h"
+
+#include <cstring>
+
+namespace chip8 {
+
+	struct Text {
+		const char* text;
+		uint8_t length;
+	};
+
+	#define TEXT(str) { str, sizeof(str) - 1 }
+
+	static const Text REGISTERS[] = {
+		TEXT("V0"), TEXT("V1"), TEXT("V2"), TEXT("V3"),
+		TEXT("V4"), TEXT("V5"), TEXT("V6"), TEXT("V7"),
+		TEXT("V8"), TEXT("V9"), TEXT("VA"), TEXT("VB"),
+		TEXT("VC"), TEXT("VD"), TEXT("VE"), TEXT("VF"),
+		TEXT("I"),
+		TEXT("ST"),
+		TEXT("DT"),
+		TEXT("<PC>"),
+		TEXT("<SP>"),
+	};
+
+	/* indexed by OpcodeType */
+	static const Text MNEMONICS[] = {
+		TEXT("<Invalid opcode>"),
+		TEXT("SYS"),
+		TEXT("CLS"),
+		TEXT("RET"),
+		TEXT("JP"),
+		TEXT("CALL"),
+		TEXT("SE"),
+		TEXT("SNE"),
+		TEXT("LD"),
+		TEXT("ADD"),
+		TEXT("OR"),
+		TEXT("AND"),
+		TEXT("XOR"),
+		TEXT("SUB"),
+		TEXT("SHR"),
+		TEXT("SUBN"),
+		TEXT("SHL"),
+		TEXT("JP"),
+		TEXT("RND"),
+		TEXT("DRW"),
+		TEXT("SKP"),
+		TEXT("SKNP"),
+		TEXT("LD"),
+		TEXT("LD"),
+		TEXT("LD"),
+		TEXT("SCD"),
+		TEXT("SCR"),
+		TEXT("SCL"),
+		TEXT("EXIT"),
+		TEXT("LOW"),
+		TEXT("HIGH"),
+		TEXT("LD"),
+		TEXT("LD"),
+		TEXT("LD"),
+		TEXT("SCU"),
+		TEXT("SAVE"),
+		TEXT("LOAD"),
+		TEXT("LD"),
+		TEXT("PLANE"),
+		TEXT("AUDIO"),
+		TEXT("PITCH"),
+	};
+
+	static_assert(sizeof(MNEMONICS) / sizeof(MNEMONICS[0]) == (size_t)OpcodeType::PITCH + 1, "Every OpcodeType needs a mnemonic");
+	static_assert(sizeof(REGISTERS) / sizeof(REGISTERS[0]) == (size_t)Register::COUNT, "Every Register needs a name");
+
+	static const char DIGITS[] = "0123456789abcdef";
+
+	static inline FormatResult Overflow(char* last) {
+		FormatResult result = { last, true };
+		return result;
+	}
+
+	static inline FormatResult Done(char* ptr) {
+		FormatResult result = { ptr, false };
+		return result;
+	}
+
+	static inline FormatResult Append(char* first, char* last, const Text& text) {
+		if ((size_t)(last - first) < text.length) {
+			return Overflow(last);
+		}
+		memcpy(first, text.text, text.length);
+		return Done(first + text.length);
+	}
+
+	static const Text INVALID_REGISTER = TEXT("<invalid-reg>");
+	static const Text SEPARATOR = TEXT(", ");
+	static const Text RANGE = TEXT(" - ");
+
+	FormatResult ToChars(char* first, char* last, Register reg) {
+		if ((size_t)reg >= (size_t)Register::COUNT) {
+			return Append(first, last, INVALID_REGISTER);
+		}
+		return Append(first, last, REGISTERS[(size_t)reg]);
+	}
+
+	FormatResult ToChars(char* first, char* last, OpcodeType type) {
+		if ((size_t)type >= sizeof(MNEMONICS) / sizeof(MNEMONICS[0])) {
+			return Append(first, last, MNEMONICS[0]);
+		}
+		return Append(first, last, MNEMONICS[(size_t)type]);
+	}
+
+	FormatResult ToChars(char* first, char* last, uint32_t value, int base, int width) {
+		if (base < 2 || base > (int)sizeof(DIGITS) - 1) {
+			return Overflow(last);
+		}
+		char digits[32];
+		int count = 0;
+		do {
+			digits[count++] = DIGITS[value % base];
+			value /= base;
+		} while (value != 0);
+		while (count < width && count < (int)sizeof(digits)) {
+			digits[count++] = '0';
+		}
+
+		if (last - first < count) {
+			return Overflow(last);
+		}
+		while (count > 0) {
+			*first++ = digits[--count];
+		}
+		return Done(first);
+	}
+
+	FormatResult ToChars(char* first, char* last, const Operand& op) {
+		FormatResult result = Done(first);
+		if (op.IsMemory()) {
+			if (result.ptr == last) return Overflow(last);
+			*result.ptr++ = '[';
+		}
+		switch (op.GetType()) {
+			case OperandType::REGISTER: {
+				result = ToChars(result.ptr, last, op.AsRegister());
+			} break;
+			case OperandType::IMMEDIATE: {
+				if (op.IsAddress()) {
+					result = ToChars(result.ptr, last, op.AsImmediate(), 16, 3);
+				}
+				else {
+					result = ToChars(result.ptr, last, op.AsImmediate(), 10);
+				}
+			} break;
+			case OperandType::NONE: {
+				/* nothing is written, not even the brackets */
+				return Done(first);
+			}
+		}
+		if (result.overflow) {
+			return result;
+		}
+		if (op.IsMemory()) {
+			if (result.ptr == last) return Overflow(last);
+			*result.ptr++ = ']';
+		}
+		return result;
+	}
+
+	FormatResult ToChars(char* first, char* last, const Opcode& opcode) {
+		static const Text F = TEXT("F, ");
+		static const Text B = TEXT("B, ");
+		static const Text HF = TEXT("HF, ");
+		static const Text R = TEXT("R, ");
+		static const Text V0 = TEXT("V0, ");
+		static const Text TO_R = TEXT(", R");
+		static const Text TO_K = TEXT(", K");
+
+		OpcodeType type = opcode.Type();
+		FormatResult result = ToChars(first, last, type);
+		if (result.overflow) {
+			return result;
+		}
+
+		/* the operands of each layout, text is written before op1 and after op2 */
+		const Text* prefix = nullptr;
+		const Text* suffix = nullptr;
+		int operands = 0;
+		bool range = false;
+
+		switch (type) {
+			case OpcodeType::SYS:
+			case OpcodeType::CALL:
+			case OpcodeType::JP:
+			case OpcodeType::SKP:
+			case OpcodeType::SKNP:
+			case OpcodeType::SCD:
+			case OpcodeType::SCU:
+			case OpcodeType::PLANE:
+			case OpcodeType::PITCH:
+				operands = 1;
+				break;
+			case OpcodeType::XOR:
+			case OpcodeType::AND:
+			case OpcodeType::OR:
+			case OpcodeType::ADD:
+			case OpcodeType::SUB:
+			case OpcodeType::SHR:
+			case OpcodeType::SUBN:
+			case OpcodeType::SHL:
+			case OpcodeType::RND:
+			case OpcodeType::LD:
+			case OpcodeType::SE:
+			case OpcodeType::SNE:
+			case OpcodeType::LD_LONG:
+				operands = 2;
+				break;
+			case OpcodeType::SAVE:
+			case OpcodeType::LOAD:
+				operands = 2;
+				range = true;
+				break;
+			case OpcodeType::DRW:
+				operands = 3;
+				break;
+			case OpcodeType::JP_V0: prefix = &V0; operands = 1; break;
+			case OpcodeType::LD_FONT: prefix = &F; operands = 1; break;
+			case OpcodeType::LD_BCD: prefix = &B; operands = 1; break;
+			case OpcodeType::LD_HFONT: prefix = &HF; operands = 1; break;
+			case OpcodeType::LD_RPL_STORE: prefix = &R; operands = 1; break;
+			case OpcodeType::LD_RPL_LOAD: suffix = &TO_R; operands = 1; break;
+			case OpcodeType::LD_KEY: suffix = &TO_K; operands = 1; break;
+			default:
+				return result;
+		}
+
+		if (result.ptr == last) return Overflow(last);
+		*result.ptr++ = ' ';
+
+		if (prefix != nullptr) {
+			result = Append(result.ptr, last, *prefix);
+			if (result.overflow) return result;
+		}
+
+		const Operand ops[3] = { opcode.Operand1(), opcode.Operand2(), opcode.Operand3() };
+		for (int k = 0; k < operands; k++) {
+			if (k > 0) {
+				result = Append(result.ptr, last, range ? RANGE : SEPARATOR);
+				if (result.overflow) return result;
+			}
+			result = ToChars(result.ptr, last, ops[k]);
+			if (result.overflow) return result;
+		}
+
+		if (suffix != nullptr) {
+			result = Append(result.ptr, last, *suffix);
+		}
+		return result;
+	}
+
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Opcode.h"
+#include "Operand.h"
+#include "Register.h"
+
+#include <cstdint>
+#include <cstddef>
+
+namespace chip8 {
+
+	/*
+	The result of the ToChars functions, like std::to_chars
+
+	ptr is one past the last written character, on overflow ptr is the
+	end of the buffer, overflow is set and the contents are unspecified
+	*/
+	struct FormatResult {
+		char* ptr;
+		bool overflow;
+	};
+
+	/* enough room for any opcode */
+	static const size_t MAX_OPCODE_CHARS = 32;
+
+	/*
+	Will write the text of the value into [first, last), without touching
+	a stream or the heap, nothing is null terminated
+	*/
+	FormatResult ToChars(char* first, char* last, Register reg);
+	FormatResult ToChars(char* first, char* last, OpcodeType type);
+	FormatResult ToChars(char* first, char* last, const Operand& op);
+	FormatResult ToChars(char* first, char* last, const Opcode& opcode);
+
+	/*
+	Will write a number in any base from 2 to 16, padded with zeros to at least width digits
+
+	any other base is reported as an overflow
+	*/
+	FormatResult ToChars(char* first, char* last, uint32_t value, int base, int width = 0);
+
+}
@@ -0,0 +1,159 @@
+#include "Framebuffer.h"
+
+#include <cstring>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define CHIP8_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace chip8 {
+
+	/*
+	Shift a whole row, positive n shifts towards pixel 0 (left),
+	negative n shifts towards pixel 127 (right)
+	*/
+	static inline Framebuffer::Row Shift(Framebuffer::Row v, int n) {
+		Framebuffer::Row r = { 0, 0 };
+		if (n >= 128 || n <= -128) {
+			return r;
+		}
+		if (n >= 64) {
+			r.hi = v.lo << (n - 64);
+		}
+		else if (n > 0) {
+			r.hi = (v.hi << n) | (v.lo >> (64 - n));
+			r.lo = v.lo << n;
+		}
+		else if (n == 0) {
+			r = v;
+		}
+		else if (n > -64) {
+			r.lo = (v.lo >> -n) | (v.hi << (64 + n));
+			r.hi = v.hi >> -n;
+		}
+		else {
+			r.lo = v.hi >> (-n - 64);
+		}
+		return r;
+	}
+
+	Framebuffer::Framebuffer()
+		: hires(false)
+	{
+		SetHighRes(false);
+	}
+
+	void Framebuffer::Clear(uint8_t planes) {
+		for (int p = 0; p < MAX_PLANES; p++) {
+			if (planes & (1 << p)) {
+				memset(rows[p], 0, sizeof(rows[p]));
+			}
+		}
+	}
+
+	void Framebuffer::SetHighRes(bool hires) {
+		this->hires = hires;
+		mask.hi = ~0ull;
+		mask.lo = hires ? ~0ull : 0;
+		memset(rows, 0, sizeof(rows));
+	}
+
+	void Framebuffer::ScrollDown(uint8_t planes, int n) {
+		int height = Height();
+		if (n > height) n = height;
+		for (int p = 0; p < MAX_PLANES; p++) {
+			if (planes & (1 << p)) {
+				memmove(&rows[p][n], &rows[p][0], (height - n) * sizeof(Row));
+				memset(&rows[p][0], 0, n * sizeof(Row));
+			}
+		}
+	}
+
+	void Framebuffer::ScrollUp(uint8_t planes, int n) {
+		int height = Height();
+		if (n > height) n = height;
+		for (int p = 0; p < MAX_PLANES; p++) {
+			if (planes & (1 << p)) {
+				memmove(&rows[p][0], &rows[p][n], (height - n) * sizeof(Row));
+				memset(&rows[p][height - n], 0, n * sizeof(Row));
+			}
+		}
+	}
+
+	void Framebuffer::ScrollRight(uint8_t planes) {
+		int height = Height();
+#ifdef CHIP8_SSE2
+		__m128i m = _mm_loadu_si128((const __m128i*)&mask);
+#endif
+		for (int p = 0; p < MAX_PLANES; p++) {
+			if (!(planes & (1 << p))) continue;
+			for (int y = 0; y < height; y++) {
+#ifdef CHIP8_SSE2
+				__m128i v = _mm_loadu_si128((const __m128i*)&rows[p][y]);
+				v = _mm_or_si128(_mm_srli_epi64(v, 4), _mm_slli_epi64(_mm_srli_si128(v, 8), 60));
+				_mm_storeu_si128((__m128i*)&rows[p][y], _mm_and_si128(v, m));
+#else
+				Row v = Shift(rows[p][y], -4);
+				rows[p][y].hi = v.hi & mask.hi;
+				rows[p][y].lo = v.lo & mask.lo;
+#endif
+			}
+		}
+	}
+
+	void Framebuffer::ScrollLeft(uint8_t planes) {
+		int height = Height();
+		for (int p = 0; p < MAX_PLANES; p++) {
+			if (!(planes & (1 << p))) continue;
+			for (int y = 0; y < height; y++) {
+#ifdef CHIP8_SSE2
+				/* nothing can be shifted in from past the right edge, so no masking is needed */
+				__m128i v = _mm_loadu_si128((const __m128i*)&rows[p][y]);
+				v = _mm_or_si128(_mm_slli_epi64(v, 4), _mm_srli_epi64(_mm_slli_si128(v, 8), 60));
+				_mm_storeu_si128((__m128i*)&rows[p][y], v);
+#else
+				rows[p][y] = Shift(rows[p][y], 4);
+#endif
+			}
+		}
+	}
+
+	bool Framebuffer::DrawRow(int plane, int x, int y, uint16_t bits, int width, bool wrap) {
+		Row sprite = { bits, 0 };
+		int shift = 128 - width - x;
+
+		Row m = Shift(sprite, shift);
+		if (wrap) {
+			Row wrapped = Shift(sprite, shift + Width());
+			m.hi |= wrapped.hi;
+			m.lo |= wrapped.lo;
+		}
+
+#ifdef CHIP8_SSE2
+		__m128i sm = _mm_and_si128(_mm_set_epi64x((long long)m.hi, (long long)m.lo), _mm_loadu_si128((const __m128i*)&mask));
+		__m128i v = _mm_loadu_si128((const __m128i*)&rows[plane][y]);
+		bool collision = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(v, sm), _mm_setzero_si128())) != 0xFFFF;
+		_mm_storeu_si128((__m128i*)&rows[plane][y], _mm_xor_si128(v, sm));
+#else
+		m.hi &= mask.hi;
+		m.lo &= mask.lo;
+		Row& v = rows[plane][y];
+		bool collision = ((v.hi & m.hi) | (v.lo & m.lo)) != 0;
+		v.hi ^= m.hi;
+		v.lo ^= m.lo;
+#endif
+		return collision;
+	}
+
+	uint8_t Framebuffer::GetPixel(int x, int y) const {
+		uint8_t color = 0;
+		for (int p = 0; p < MAX_PLANES; p++) {
+			const Row& row = rows[p][y];
+			uint64_t bit = x < 64 ? (row.hi >> (63 - x)) : (row.lo >> (127 - x));
+			color |= (bit & 1) << p;
+		}
+		return color;
+	}
+
+}
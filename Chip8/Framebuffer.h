@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+
+namespace chip8 {
+
+	class Framebuffer {
+	public:
+		static const int MAX_WIDTH = 128;
+		static const int MAX_HEIGHT = 64;
+		static const int MAX_PLANES = 4;
+
+		/*
+		A single packed row of a plane, seen as one 128 bit number
+		pixel 0 is the most significant bit of hi and pixel 127 the least significant bit of lo
+
+		in low resolution only the first 64 pixels (hi) are used
+		*/
+		struct alignas(16) Row {
+			uint64_t lo;
+			uint64_t hi;
+		};
+
+		Framebuffer();
+
+		/*
+		Will clear the planes in the given plane mask
+		*/
+		void Clear(uint8_t planes);
+
+		/*
+		Will switch between 64x32 and 128x64, clears all the planes
+		*/
+		void SetHighRes(bool hires);
+
+		inline bool IsHighRes() const { return hires; }
+		inline int Width() const { return hires ? 128 : 64; }
+		inline int Height() const { return hires ? 64 : 32; }
+
+		/*
+		Will scroll the planes in the given plane mask, the scrolls work on whole rows
+		*/
+		void ScrollDown(uint8_t planes, int n);
+		void ScrollUp(uint8_t planes, int n);
+		void ScrollRight(uint8_t planes);
+		void ScrollLeft(uint8_t planes);
+
+		/*
+		Will xor a single sprite row into a plane
+
+		bits holds width (8 or 16) pixels, the leftmost pixel at the most significant bit
+		x must already be inside the screen, pixels going past the right edge are
+		clipped, or wrapped around to the left edge if wrap is true
+
+		returns true if any pixel was turned off
+		*/
+		bool DrawRow(int plane, int x, int y, uint16_t bits, int width, bool wrap);
+
+		inline const Row& GetRow(int plane, int y) const { return rows[plane][y]; }
+
+		/*
+		Return the combined plane bits of a single pixel, plane 0 is bit 0
+		*/
+		uint8_t GetPixel(int x, int y) const;
+
+	private:
+		bool hires;
+		Row mask;
+		Row rows[MAX_PLANES][MAX_HEIGHT];
+
+	};
+
+}
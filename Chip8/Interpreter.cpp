@@ -0,0 +1,602 @@
+#include "Interpreter.h"
+
+#include "Formatter.h"
+#include "Debugger.h"
+#include "Statistics.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+namespace chip8 {
+
+	Interpreter::Interpreter(Machine& machine)
+		: m(machine)
+		, runner(SelectRunner(machine.quirks, std::make_index_sequence<1 << QUIRK_COUNT>()))
+		, runnerQuirks(machine.quirks)
+		, blocks()
+		, pageFlags(machine.MemorySize() >> 8, 0)
+		, debugger(nullptr)
+		, coverage(nullptr)
+		, traps()
+	{
+	}
+
+	uint64_t Interpreter::Run(uint64_t cycles) {
+		if (runnerQuirks != m.quirks) {
+			runner = SelectRunner(m.quirks, std::make_index_sequence<1 << QUIRK_COUNT>());
+			runnerQuirks = m.quirks;
+		}
+		return (this->*runner)(cycles);
+	}
+
+	template <size_t... Quirks>
+	Interpreter::Runner Interpreter::SelectRunner(uint32_t quirks, std::index_sequence<Quirks...>) {
+		static const Runner runners[] = { &Interpreter::RunWithQuirks<(uint32_t)Quirks>... };
+		return runners[quirks];
+	}
+
+	template <uint32_t Quirks>
+	uint64_t Interpreter::RunWithQuirks(uint64_t cycles) {
+		/*
+		DT and the keys only change between calls, so once a run of pure blocks
+		comes back to where it started with the same registers, every further
+		iteration does the same, those iterations are skipped and only the
+		partial iteration at the end is executed, breakpoints turn this off
+		*/
+		bool fastForward = traps.empty();
+		uint32_t idleHead = NO_IDLE_HEAD;
+		uint64_t idleStart = 0;
+		uint8_t idleRegisters[16];
+
+		uint64_t executed = 0;
+		while (executed < cycles && m.state == MachineState::RUNNING) {
+			const Block& block = Lookup(m.pc);
+			if (block.trap && !Trap(block.start)) {
+				break;
+			}
+			if (!block.pure || !fastForward) {
+				idleHead = NO_IDLE_HEAD;
+			}
+			else if (block.start == idleHead && memcmp(idleRegisters, m.v, sizeof(m.v)) == 0) {
+				uint64_t period = executed - idleStart;
+				executed += (cycles - executed) / period * period;
+				idleHead = NO_IDLE_HEAD;
+				if (executed == cycles) {
+					break;
+				}
+			}
+			else if (block.start == idleHead || idleHead == NO_IDLE_HEAD || executed - idleStart > MAX_IDLE_PERIOD) {
+				idleHead = block.start;
+				idleStart = executed;
+				memcpy(idleRegisters, m.v, sizeof(m.v));
+			}
+			const Instruction* code = block.code.data();
+			size_t count = block.code.size();
+			if (count > cycles - executed) {
+				count = (size_t)(cycles - executed);
+			}
+
+			/*
+			only the last instruction of a block can write to memory,
+			so the block is never touched after it could have been dropped,
+			which is also why the coverage is marked before running it
+			*/
+			if (coverage != nullptr) {
+				for (size_t k = 0; k < count; k++) {
+					if (code[k].op != Operation::INVALID) {
+						coverage[code[k].address] = 1;
+					}
+				}
+			}
+			for (size_t k = 0; k < count; k++) {
+				Execute<Quirks>(code[k]);
+			}
+			executed += count;
+		}
+		return executed;
+	}
+
+	void Interpreter::RunFrame(uint32_t cyclesPerFrame) {
+		Run(cyclesPerFrame);
+		m.TickTimers();
+	}
+
+	void Interpreter::Invalidate(uint32_t address, uint32_t size) {
+		uint32_t end = address + size;
+		for (auto it = blocks.begin(); it != blocks.end();) {
+			if (it->second.start < end && address < it->second.end) {
+				it = blocks.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+	}
+
+	void Interpreter::Flush() {
+		blocks.clear();
+		for (uint8_t& flags : pageFlags) {
+			flags &= ~PAGE_CODE;
+		}
+	}
+
+	void Interpreter::Load(std::shared_ptr<const MemoryImage> image) {
+		if (image != m.image) {
+			m.Load(std::move(image));
+			Flush();
+			return;
+		}
+		for (uint32_t page : m.dirty) {
+			if (pageFlags[page] & PAGE_CODE) {
+				Invalidate(page << Machine::PAGE_SHIFT, Machine::PAGE_SIZE);
+			}
+		}
+		m.Load(std::move(image));
+	}
+
+	void Interpreter::OnWrite(uint32_t address) {
+		uint8_t flags = pageFlags[address >> 8];
+		if (flags & PAGE_CODE) {
+			Invalidate(address, 1);
+		}
+		/* a store always ends its block, so the machine stops right after it */
+		if ((flags & PAGE_WATCH) && debugger != nullptr && debugger->OnWrite((uint16_t)address)) {
+			m.state = MachineState::BREAK;
+		}
+	}
+
+	bool Interpreter::Trap(uint16_t address) {
+		if (debugger != nullptr && debugger->OnBreakpoint(address)) {
+			m.state = MachineState::BREAK;
+			return false;
+		}
+		return true;
+	}
+
+	void Interpreter::SetTrap(uint16_t address, bool set) {
+		if (set) {
+			traps.insert(address);
+		}
+		else {
+			traps.erase(address);
+		}
+		/* the blocks running over the address have to be split again */
+		Invalidate(address, 1);
+	}
+
+	void Interpreter::SetWatch(uint32_t address, uint32_t size) {
+		for (uint32_t page = address >> 8; page <= ((address + size - 1) >> 8) && page < pageFlags.size(); page++) {
+			pageFlags[page] |= PAGE_WATCH;
+		}
+	}
+
+	void Interpreter::ClearWatches() {
+		for (uint8_t& flags : pageFlags) {
+			flags &= ~PAGE_WATCH;
+		}
+	}
+
+	Interpreter::Block& Interpreter::Lookup(uint16_t address) {
+		auto it = blocks.find(address);
+		if (it != blocks.end()) {
+			Statistics::Count(Counter::CACHE_HITS);
+			return it->second;
+		}
+
+		Statistics::Count(Counter::CACHE_MISSES);
+		Block& block = blocks.emplace(address, Compile(address)).first->second;
+		for (uint32_t page = block.start >> 8; page <= ((block.end - 1) >> 8) && page < pageFlags.size(); page++) {
+			pageFlags[page] |= PAGE_CODE;
+		}
+		return block;
+	}
+
+	Interpreter::Block Interpreter::Compile(uint16_t address) const {
+		Block block;
+		block.start = address;
+		block.trap = !traps.empty() && traps.count(address) != 0;
+		block.pure = true;
+
+		uint32_t pc = address;
+		while (true) {
+			uint16_t bin = (Load(pc) << 8) | Load(pc + 1);
+			uint16_t ext = (Load(pc + 2) << 8) | Load(pc + 3);
+
+			Instruction ins;
+			try {
+				ins = Lower(Opcode(bin, ext, true));
+			}
+			catch (const std::runtime_error&) {
+				ins = Instruction();
+			}
+			/* this is also hit by extensions that are not part of the variant */
+			if (ins.op == Operation::INVALID) {
+				ins.imm = bin;
+				ins.length = 2;
+			}
+			ins.address = (uint16_t)pc;
+			block.code.push_back(ins);
+			block.pure = block.pure && IsPure(ins.op);
+
+			pc += ins.length;
+			if (EndsBlock(ins.op) || block.code.size() >= MAX_BLOCK_SIZE || pc + 1 > m.addressMask) {
+				break;
+			}
+			if (!traps.empty() && traps.count((uint16_t)pc) != 0) {
+				break;
+			}
+		}
+		block.end = pc;
+		return block;
+	}
+
+	Interpreter::Instruction Interpreter::Lower(const Opcode& opcode) const {
+		Instruction ins = Instruction();
+		ins.length = opcode.Length();
+
+		Operand op1 = opcode.Operand1();
+		Operand op2 = opcode.Operand2();
+		bool schip = m.variant != Variant::CHIP8;
+		bool xochip = m.variant == Variant::XOCHIP;
+
+		auto reg = [](const Operand& op) { return (uint8_t)op.AsRegister(true); };
+
+		switch (opcode.Type()) {
+			case OpcodeType::NONE:
+			case OpcodeType::SYS: ins.op = Operation::NOP; break;
+			case OpcodeType::CLS: ins.op = Operation::CLS; break;
+			case OpcodeType::RET: ins.op = Operation::RET; break;
+			case OpcodeType::JP: ins.op = Operation::JP; ins.imm = op1.AsImmediate(); break;
+			case OpcodeType::CALL: ins.op = Operation::CALL; ins.imm = op1.AsImmediate(); break;
+			case OpcodeType::JP_V0: {
+				/* the register is only used with QUIRK_JUMP_VX */
+				ins.op = Operation::JP_V0;
+				ins.imm = op1.AsImmediate();
+				ins.x = (ins.imm >> 8) & 0xF;
+			} break;
+			case OpcodeType::SE:
+			case OpcodeType::SNE: {
+				bool se = opcode.Type() == OpcodeType::SE;
+				ins.x = reg(op1);
+				if (op2.GetType() == OperandType::IMMEDIATE) {
+					ins.op = se ? Operation::SE_IMM : Operation::SNE_IMM;
+					ins.imm = op2.AsImmediate();
+				}
+				else {
+					ins.op = se ? Operation::SE_REG : Operation::SNE_REG;
+					ins.y = reg(op2);
+				}
+			} break;
+			case OpcodeType::LD: {
+				switch (op1.AsRegister()) {
+					case Register::DT: ins.op = Operation::LD_DT_V; ins.x = reg(op2); break;
+					case Register::ST: ins.op = Operation::LD_ST_V; ins.x = reg(op2); break;
+					case Register::I: {
+						if (op1.IsMemory()) {
+							ins.op = Operation::STORE; ins.x = reg(op2);
+						}
+						else {
+							ins.op = Operation::LD_I; ins.imm = op2.AsImmediate();
+						}
+					} break;
+					default: {
+						ins.x = reg(op1);
+						if (op2.GetType() == OperandType::IMMEDIATE) {
+							ins.op = Operation::LD_IMM; ins.imm = op2.AsImmediate();
+						}
+						else {
+							switch (op2.AsRegister()) {
+								case Register::DT: ins.op = Operation::LD_V_DT; break;
+								case Register::I: ins.op = Operation::LOAD; break;
+								default: ins.op = Operation::LD_REG; ins.y = reg(op2); break;
+							}
+						}
+					} break;
+				}
+			} break;
+			case OpcodeType::ADD: {
+				if (op1.AsRegister() == Register::I) {
+					ins.op = Operation::ADD_I_V; ins.x = reg(op2);
+				}
+				else if (op2.GetType() == OperandType::IMMEDIATE) {
+					ins.op = Operation::ADD_IMM; ins.x = reg(op1); ins.imm = op2.AsImmediate();
+				}
+				else {
+					ins.op = Operation::ADD_REG; ins.x = reg(op1); ins.y = reg(op2);
+				}
+			} break;
+			case OpcodeType::OR: ins.op = Operation::OR; ins.x = reg(op1); ins.y = reg(op2); break;
+			case OpcodeType::AND: ins.op = Operation::AND; ins.x = reg(op1); ins.y = reg(op2); break;
+			case OpcodeType::XOR: ins.op = Operation::XOR; ins.x = reg(op1); ins.y = reg(op2); break;
+			case OpcodeType::SUB: ins.op = Operation::SUB; ins.x = reg(op1); ins.y = reg(op2); break;
+			case OpcodeType::SUBN: ins.op = Operation::SUBN; ins.x = reg(op1); ins.y = reg(op2); break;
+			case OpcodeType::SHR: ins.op = Operation::SHR; ins.x = reg(op1); ins.y = reg(op2); break;
+			case OpcodeType::SHL: ins.op = Operation::SHL; ins.x = reg(op1); ins.y = reg(op2); break;
+			case OpcodeType::RND: ins.op = Operation::RND; ins.x = reg(op1); ins.imm = op2.AsImmediate(); break;
+			case OpcodeType::DRW: {
+				ins.op = Operation::DRW;
+				ins.x = reg(op1);
+				ins.y = reg(op2);
+				ins.n = (uint8_t)opcode.Operand3().AsImmediate();
+			} break;
+			case OpcodeType::SKP: ins.op = Operation::SKP; ins.x = reg(op1); break;
+			case OpcodeType::SKNP: ins.op = Operation::SKNP; ins.x = reg(op1); break;
+			case OpcodeType::LD_FONT: ins.op = Operation::LD_FONT; ins.x = reg(op1); break;
+			case OpcodeType::LD_BCD: ins.op = Operation::LD_BCD; ins.x = reg(op1); break;
+			case OpcodeType::LD_KEY: ins.op = Operation::LD_KEY; ins.x = reg(op1); break;
+
+			case OpcodeType::SCD: if (schip) { ins.op = Operation::SCD; ins.n = (uint8_t)op1.AsImmediate(); } break;
+			case OpcodeType::SCR: if (schip) { ins.op = Operation::SCR; } break;
+			case OpcodeType::SCL: if (schip) { ins.op = Operation::SCL; } break;
+			case OpcodeType::EXIT: if (schip) { ins.op = Operation::EXIT; } break;
+			case OpcodeType::LOW: if (schip) { ins.op = Operation::LOW; } break;
+			case OpcodeType::HIGH: if (schip) { ins.op = Operation::HIGH; } break;
+			case OpcodeType::LD_HFONT: if (schip) { ins.op = Operation::LD_HFONT; ins.x = reg(op1); } break;
+			case OpcodeType::LD_RPL_STORE: if (schip) { ins.op = Operation::LD_RPL_STORE; ins.x = reg(op1); } break;
+			case OpcodeType::LD_RPL_LOAD: if (schip) { ins.op = Operation::LD_RPL_LOAD; ins.x = reg(op1); } break;
+
+			case OpcodeType::SCU: if (xochip) { ins.op = Operation::SCU; ins.n = (uint8_t)op1.AsImmediate(); } break;
+			case OpcodeType::SAVE: if (xochip) { ins.op = Operation::SAVE_RANGE; ins.x = reg(op1); ins.y = reg(op2); } break;
+			case OpcodeType::LOAD: if (xochip) { ins.op = Operation::LOAD_RANGE; ins.x = reg(op1); ins.y = reg(op2); } break;
+			case OpcodeType::LD_LONG: if (xochip) { ins.op = Operation::LD_LONG; ins.imm = op2.AsImmediate(); } break;
+			case OpcodeType::PLANE: if (xochip) { ins.op = Operation::PLANE; ins.n = (uint8_t)op1.AsImmediate(); } break;
+			case OpcodeType::AUDIO: if (xochip) { ins.op = Operation::AUDIO; } break;
+			case OpcodeType::PITCH: if (xochip) { ins.op = Operation::PITCH; ins.x = reg(op1); } break;
+		}
+
+		return ins;
+	}
+
+	bool Interpreter::EndsBlock(Operation op) {
+		switch (op) {
+			case Operation::INVALID:
+			case Operation::RET:
+			case Operation::JP:
+			case Operation::CALL:
+			case Operation::JP_V0:
+			case Operation::SE_IMM:
+			case Operation::SE_REG:
+			case Operation::SNE_IMM:
+			case Operation::SNE_REG:
+			case Operation::SKP:
+			case Operation::SKNP:
+			case Operation::LD_KEY:
+			case Operation::EXIT:
+			/* the instructions that write to memory */
+			case Operation::LD_BCD:
+			case Operation::STORE:
+			case Operation::SAVE_RANGE:
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	bool Interpreter::IsPure(Operation op) {
+		switch (op) {
+			case Operation::NOP:
+			case Operation::JP:
+			case Operation::JP_V0:
+			case Operation::SE_IMM:
+			case Operation::SE_REG:
+			case Operation::SNE_IMM:
+			case Operation::SNE_REG:
+			case Operation::SKP:
+			case Operation::SKNP:
+			case Operation::LD_IMM:
+			case Operation::LD_REG:
+			case Operation::LD_V_DT:
+			case Operation::ADD_IMM:
+			case Operation::ADD_REG:
+			case Operation::OR:
+			case Operation::AND:
+			case Operation::XOR:
+			case Operation::SUB:
+			case Operation::SUBN:
+			case Operation::SHR:
+			case Operation::SHL:
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	void Interpreter::Skip() {
+		/* XO-CHIP skips over the whole 4 byte LD I, <long> */
+		if (m.variant == Variant::XOCHIP && Load(m.pc) == 0xF0 && Load(m.pc + 1) == 0x00) {
+			m.pc = (m.pc + 4) & m.addressMask;
+		}
+		else {
+			m.pc = (m.pc + 2) & m.addressMask;
+		}
+	}
+
+	template <uint32_t Quirks>
+	void Interpreter::Draw(uint8_t x, uint8_t y, uint8_t n) {
+		Framebuffer& display = m.display;
+		int width = display.Width();
+		int height = display.Height();
+		int px = m.v[x] % width;
+		int py = m.v[y] % height;
+
+		int spriteWidth = 8;
+		int rows = n;
+		if (n == 0 && m.variant != Variant::CHIP8) {
+			spriteWidth = 16;
+			rows = 16;
+		}
+
+		/* every selected plane takes its own sprite data, one after the other */
+		uint32_t address = m.i;
+		bool collision = false;
+		for (int p = 0; p < Framebuffer::MAX_PLANES; p++) {
+			if (!(m.planes & (1 << p))) {
+				continue;
+			}
+			for (int r = 0; r < rows; r++) {
+				uint16_t bits = Load(address++);
+				if (spriteWidth == 16) {
+					bits = (bits << 8) | Load(address++);
+				}
+				if (Quirks & QUIRK_WRAP) {
+					collision |= display.DrawRow(p, px, (py + r) % height, bits, spriteWidth, true);
+				}
+				else if (py + r < height) {
+					collision |= display.DrawRow(p, px, py + r, bits, spriteWidth, false);
+				}
+			}
+		}
+		m.v[0xF] = collision ? 1 : 0;
+	}
+
+	template <uint32_t Quirks>
+	void Interpreter::Execute(Instruction ins) {
+		uint8_t* v = m.v;
+		m.pc = (ins.address + ins.length) & m.addressMask;
+
+		switch (ins.op) {
+			case Operation::INVALID: {
+				m.pc = ins.address;
+				throw InvalidOpcodeError(Formatter() << "Invalid opcode " << std::hex << ins.imm << " at " << std::hex << ins.address);
+			}
+			case Operation::NOP: break;
+			case Operation::CLS: m.display.Clear(m.planes); break;
+			case Operation::RET: {
+				if (m.sp == 0) {
+					m.pc = ins.address;
+					throw StackError(Formatter() << "Stack underflow at " << std::hex << ins.address);
+				}
+				m.pc = m.stack[--m.sp];
+			} break;
+			case Operation::JP: m.pc = ins.imm; break;
+			case Operation::CALL: {
+				if (m.sp == Machine::STACK_SIZE) {
+					m.pc = ins.address;
+					throw StackError(Formatter() << "Stack overflow at " << std::hex << ins.address);
+				}
+				m.stack[m.sp++] = m.pc;
+				m.pc = ins.imm;
+			} break;
+			case Operation::SE_IMM: if (v[ins.x] == ins.imm) Skip(); break;
+			case Operation::SE_REG: if (v[ins.x] == v[ins.y]) Skip(); break;
+			case Operation::SNE_IMM: if (v[ins.x] != ins.imm) Skip(); break;
+			case Operation::SNE_REG: if (v[ins.x] != v[ins.y]) Skip(); break;
+			case Operation::LD_IMM: v[ins.x] = (uint8_t)ins.imm; break;
+			case Operation::LD_REG: v[ins.x] = v[ins.y]; break;
+			case Operation::ADD_IMM: v[ins.x] += (uint8_t)ins.imm; break;
+			case Operation::ADD_REG: {
+				uint16_t sum = v[ins.x] + v[ins.y];
+				v[ins.x] = (uint8_t)sum;
+				v[0xF] = sum > 0xFF ? 1 : 0;
+			} break;
+			case Operation::OR: v[ins.x] |= v[ins.y]; if (Quirks & QUIRK_VF_RESET) v[0xF] = 0; break;
+			case Operation::AND: v[ins.x] &= v[ins.y]; if (Quirks & QUIRK_VF_RESET) v[0xF] = 0; break;
+			case Operation::XOR: v[ins.x] ^= v[ins.y]; if (Quirks & QUIRK_VF_RESET) v[0xF] = 0; break;
+			case Operation::SUB: {
+				uint8_t flag = v[ins.x] >= v[ins.y] ? 1 : 0;
+				v[ins.x] -= v[ins.y];
+				v[0xF] = flag;
+			} break;
+			case Operation::SUBN: {
+				uint8_t flag = v[ins.y] >= v[ins.x] ? 1 : 0;
+				v[ins.x] = v[ins.y] - v[ins.x];
+				v[0xF] = flag;
+			} break;
+			case Operation::SHR: {
+				uint8_t value = (Quirks & QUIRK_SHIFT_VX) ? v[ins.x] : v[ins.y];
+				v[ins.x] = value >> 1;
+				v[0xF] = value & 1;
+			} break;
+			case Operation::SHL: {
+				uint8_t value = (Quirks & QUIRK_SHIFT_VX) ? v[ins.x] : v[ins.y];
+				v[ins.x] = value << 1;
+				v[0xF] = value >> 7;
+			} break;
+			case Operation::LD_I: m.i = ins.imm; break;
+			case Operation::JP_V0: m.pc = (ins.imm + v[(Quirks & QUIRK_JUMP_VX) ? ins.x : 0]) & m.addressMask; break;
+			case Operation::RND: {
+				m.random ^= m.random << 13;
+				m.random ^= m.random >> 17;
+				m.random ^= m.random << 5;
+				v[ins.x] = (uint8_t)(m.random >> 8) & (uint8_t)ins.imm;
+			} break;
+			case Operation::DRW: Draw<Quirks>(ins.x, ins.y, ins.n); break;
+			case Operation::SKP: if (m.keys & (1 << (v[ins.x] & 0xF))) Skip(); break;
+			case Operation::SKNP: if (!(m.keys & (1 << (v[ins.x] & 0xF)))) Skip(); break;
+			case Operation::LD_V_DT: v[ins.x] = m.dt; break;
+			case Operation::LD_KEY: {
+				m.state = MachineState::WAITING_KEY;
+				m.waitRegister = ins.x;
+			} break;
+			case Operation::LD_DT_V: m.dt = v[ins.x]; break;
+			case Operation::LD_ST_V: m.st = v[ins.x]; break;
+			case Operation::ADD_I_V: m.i += v[ins.x]; break;
+			case Operation::LD_FONT: m.i = Machine::FONT_ADDRESS + (v[ins.x] & 0xF) * 5; break;
+			case Operation::LD_HFONT: m.i = Machine::HFONT_ADDRESS + (v[ins.x] & 0xF) * 10; break;
+			case Operation::LD_BCD: {
+				uint8_t value = v[ins.x];
+				Store(m.i, value / 100);
+				Store(m.i + 1, (value / 10) % 10);
+				Store(m.i + 2, value % 10);
+			} break;
+			case Operation::STORE: {
+				uint16_t address = m.i;
+				if (!(Quirks & QUIRK_LOAD_STORE_KEEP_I)) {
+					m.i += ins.x + 1;
+				}
+				for (int r = 0; r <= ins.x; r++) {
+					Store(address + r, v[r]);
+				}
+			} break;
+			case Operation::LOAD: {
+				for (int r = 0; r <= ins.x; r++) {
+					v[r] = Load(m.i + r);
+				}
+				if (!(Quirks & QUIRK_LOAD_STORE_KEEP_I)) {
+					m.i += ins.x + 1;
+				}
+			} break;
+			case Operation::SCD: m.display.ScrollDown(m.planes, ins.n); break;
+			case Operation::SCU: m.display.ScrollUp(m.planes, ins.n); break;
+			case Operation::SCR: m.display.ScrollRight(m.planes); break;
+			case Operation::SCL: m.display.ScrollLeft(m.planes); break;
+			case Operation::EXIT: m.state = MachineState::HALTED; break;
+			case Operation::LOW: m.display.SetHighRes(false); break;
+			case Operation::HIGH: m.display.SetHighRes(true); break;
+			case Operation::LD_RPL_STORE: {
+				for (int r = 0; r <= ins.x; r++) {
+					m.rpl[r] = v[r];
+				}
+			} break;
+			case Operation::LD_RPL_LOAD: {
+				for (int r = 0; r <= ins.x; r++) {
+					v[r] = m.rpl[r];
+				}
+			} break;
+			case Operation::SAVE_RANGE: {
+				int step = ins.x <= ins.y ? 1 : -1;
+				for (int r = ins.x, k = 0; ; r += step, k++) {
+					Store(m.i + k, v[r]);
+					if (r == ins.y) break;
+				}
+			} break;
+			case Operation::LOAD_RANGE: {
+				int step = ins.x <= ins.y ? 1 : -1;
+				for (int r = ins.x, k = 0; ; r += step, k++) {
+					v[r] = Load(m.i + k);
+					if (r == ins.y) break;
+				}
+			} break;
+			case Operation::LD_LONG: m.i = ins.imm; break;
+			case Operation::PLANE: m.planes = ins.n; break;
+			case Operation::AUDIO: {
+				for (int k = 0; k < 16; k++) {
+					m.pattern[k] = Load(m.i + k);
+				}
+			} break;
+			case Operation::PITCH: m.pitch = v[ins.x]; break;
+		}
+	}
+
+}
@@ -0,0 +1,240 @@
+#pragma once
+
+#include "Machine.h"
+#include "Opcode.h"
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+namespace chip8 {
+
+	class Debugger;
+
+	/* thrown when the machine runs a word that is not an instruction of its variant */
+	class InvalidOpcodeError : public std::runtime_error {
+	public:
+		using std::runtime_error::runtime_error;
+	};
+
+	/* thrown by RET on an empty stack and CALL on a full one */
+	class StackError : public std::runtime_error {
+	public:
+		using std::runtime_error::runtime_error;
+	};
+
+	/*
+	Executes a machine by decoding straight-line runs of instructions into
+	blocks once, and then running the cached blocks
+
+	writes to memory that holds cached code will drop the affected blocks,
+	so self modifying roms work
+
+	the execution loop is instantiated once for every combination of quirks,
+	the machine's quirks only pick which instance runs
+
+	loops that only poll the delay timer or the keys are fast forwarded
+	to the end of the cycles given to Run, the next point at which the
+	timers or keys can change
+	*/
+	class Interpreter {
+	public:
+		/* the maximum amount of instructions in a single block */
+		static const size_t MAX_BLOCK_SIZE = 64;
+		/* the longest loop, in instructions, that can be fast forwarded */
+		static const uint64_t MAX_IDLE_PERIOD = 256;
+
+		Interpreter(Machine& machine);
+		Interpreter(const Interpreter&) = delete;
+		Interpreter& operator=(const Interpreter&) = delete;
+
+		/*
+		Will run up to the given amount of instructions, stops early if the
+		machine is waiting for a key or halted
+
+		returns the amount of instructions that were executed
+		*/
+		uint64_t Run(uint64_t cycles);
+
+		/*
+		Will run a single 60hz frame, cyclesPerFrame instructions followed by a timer tick
+		*/
+		void RunFrame(uint32_t cyclesPerFrame);
+
+		/*
+		Will drop any cached block that covers the given range,
+		must be called when memory is changed behind the interpreter's back
+		*/
+		void Invalidate(uint32_t address, uint32_t size);
+
+		/*
+		Will drop all the cached blocks
+		*/
+		void Flush();
+
+		/*
+		Will reset the machine to the given image, if it is the image the machine
+		already runs only the blocks on pages the machine wrote to are dropped,
+		so a machine that is reused for the same rom keeps its decoded blocks
+		*/
+		void Load(std::shared_ptr<const MemoryImage> image);
+
+		/*
+		Will mark the address of every instruction that is run, invalid ones are
+		never marked, coverage must have a flag for every address of memory or
+		be null to stop recording
+		*/
+		inline void SetCoverage(uint8_t* coverage) { this->coverage = coverage; }
+
+		inline Machine& GetMachine() { return m; }
+
+	private:
+		friend class Debugger;
+
+		/* the flags kept for every 256 byte page */
+		enum PageFlags : uint8_t {
+			/* a cached block covers the page */
+			PAGE_CODE = 1 << 0,
+			/* a debugger watches part of the page */
+			PAGE_WATCH = 1 << 1,
+		};
+
+		/*
+		The instructions after lowering, unlike OpcodeType every
+		operation has exactly one meaning
+		*/
+		enum class Operation : uint8_t {
+			INVALID,
+			NOP,
+			CLS,
+			RET,
+			JP,
+			CALL,
+			SE_IMM,
+			SE_REG,
+			SNE_IMM,
+			SNE_REG,
+			LD_IMM,
+			LD_REG,
+			ADD_IMM,
+			ADD_REG,
+			OR,
+			AND,
+			XOR,
+			SUB,
+			SHR,
+			SUBN,
+			SHL,
+			LD_I,
+			JP_V0,
+			RND,
+			DRW,
+			SKP,
+			SKNP,
+			LD_V_DT,
+			LD_KEY,
+			LD_DT_V,
+			LD_ST_V,
+			ADD_I_V,
+			LD_FONT,
+			LD_BCD,
+			STORE,
+			LOAD,
+			SCD,
+			SCR,
+			SCL,
+			EXIT,
+			LOW,
+			HIGH,
+			LD_HFONT,
+			LD_RPL_STORE,
+			LD_RPL_LOAD,
+			SCU,
+			SAVE_RANGE,
+			LOAD_RANGE,
+			LD_LONG,
+			PLANE,
+			AUDIO,
+			PITCH,
+		};
+
+		struct Instruction {
+			Operation op;
+			uint8_t x, y, n;
+			uint16_t imm;
+			uint16_t address;
+			uint8_t length;
+		};
+
+		struct Block {
+			uint16_t start;
+			/* the address right after the last instruction */
+			uint32_t end;
+			/* the block starts at a breakpoint, the debugger is asked before running it */
+			bool trap;
+			/* the block only changes V0-VF and PC, from themselves, DT and the keys */
+			bool pure;
+			std::vector<Instruction> code;
+		};
+
+		typedef uint64_t (Interpreter::*Runner)(uint64_t cycles);
+
+		/* above every address, so no block starts there */
+		static const uint32_t NO_IDLE_HEAD = 0x10000;
+
+		template <size_t... Quirks>
+		static Runner SelectRunner(uint32_t quirks, std::index_sequence<Quirks...>);
+
+		template <uint32_t Quirks>
+		uint64_t RunWithQuirks(uint64_t cycles);
+
+		Block& Lookup(uint16_t address);
+		Block Compile(uint16_t address) const;
+		Instruction Lower(const Opcode& opcode) const;
+		static bool EndsBlock(Operation op);
+		static bool IsPure(Operation op);
+
+		template <uint32_t Quirks>
+		void Execute(Instruction ins);
+
+		template <uint32_t Quirks>
+		void Draw(uint8_t x, uint8_t y, uint8_t n);
+
+		void Skip();
+
+		inline uint8_t Load(uint32_t address) const {
+			return m.Read(address);
+		}
+
+		inline void Store(uint32_t address, uint8_t value) {
+			address &= m.addressMask;
+			m.Write(address, value);
+			if (pageFlags[address >> 8]) {
+				OnWrite(address);
+			}
+		}
+
+		void OnWrite(uint32_t address);
+		bool Trap(uint16_t address);
+		void SetTrap(uint16_t address, bool set);
+		void SetWatch(uint32_t address, uint32_t size);
+		void ClearWatches();
+
+		Machine& m;
+		Runner runner;
+		uint32_t runnerQuirks;
+		std::unordered_map<uint16_t, Block> blocks;
+		/* PageFlags for every 256 byte page of memory */
+		std::vector<uint8_t> pageFlags;
+
+		Debugger* debugger;
+		uint8_t* coverage;
+		/* the breakpoint addresses, blocks are split so these always start a block */
+		std::unordered_set<uint16_t> traps;
+
+	};
+
+}
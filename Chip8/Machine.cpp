@@ -0,0 +1,197 @@
+#include "Machine.h"
+
+#include "Formatter.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace chip8 {
+
+	static const uint8_t FONT[16 * 5] = {
+		0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+		0x20, 0x60, 0x20, 0x20, 0x70, // 1
+		0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+		0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+		0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+		0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+		0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+		0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+		0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+		0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+		0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+		0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+		0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+		0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+		0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+		0xF0, 0x80, 0xF0, 0x80, 0x80, // F
+	};
+
+	static const uint8_t HFONT[16 * 10] = {
+		0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+		0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+		0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+		0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+		0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+		0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+		0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+		0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+		0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+		0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+		0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+		0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+		0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+		0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+		0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+		0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0, // F
+	};
+
+	uint32_t DefaultQuirks(Variant variant) {
+		switch (variant) {
+			case Variant::CHIP8: return QUIRK_VF_RESET;
+			case Variant::SCHIP: return QUIRK_SHIFT_VX | QUIRK_LOAD_STORE_KEEP_I | QUIRK_JUMP_VX;
+			case Variant::XOCHIP: return QUIRK_WRAP;
+			default: {
+				throw std::runtime_error(Formatter() << "Invalid variant " << (int)variant);
+			}
+		}
+	}
+
+	MemoryImage::MemoryImage(Variant variant, const uint8_t* rom, size_t size)
+		: variant(variant)
+		, bytes(variant == Variant::XOCHIP ? 0x10000 : 0x1000, 0)
+	{
+		if (size > bytes.size() - Machine::START_ADDRESS) {
+			throw std::runtime_error(Formatter() << "Rom of " << size << " bytes does not fit in " << bytes.size() << " bytes of memory");
+		}
+		memcpy(&bytes[Machine::FONT_ADDRESS], FONT, sizeof(FONT));
+		memcpy(&bytes[Machine::HFONT_ADDRESS], HFONT, sizeof(HFONT));
+		if (size > 0) {
+			memcpy(&bytes[Machine::START_ADDRESS], rom, size);
+		}
+	}
+
+	Machine::Machine(Variant variant)
+		: Machine(variant, DefaultQuirks(variant))
+	{
+	}
+
+	Machine::Machine(Variant variant, uint32_t quirks)
+		: Machine(std::make_shared<MemoryImage>(variant), quirks)
+	{
+	}
+
+	Machine::Machine(std::shared_ptr<const MemoryImage> image, uint32_t quirks)
+		: variant(image->GetVariant())
+		, quirks(quirks & QUIRK_ALL)
+		, image(image)
+		, pages(image->Size() >> PAGE_SHIFT)
+		, copies(image->Size() >> PAGE_SHIFT)
+		, addressMask((uint16_t)(image->Size() - 1))
+	{
+		Load(image);
+	}
+
+	void Machine::LoadRom(const uint8_t* rom, size_t size) {
+		Load(std::make_shared<MemoryImage>(variant, rom, size));
+	}
+
+	void Machine::Load(std::shared_ptr<const MemoryImage> image) {
+		if (image->GetVariant() != variant) {
+			throw std::runtime_error(Formatter() << "Attempted to load an image of variant " << (int)image->GetVariant() << " into a machine of variant " << (int)variant);
+		}
+		this->image = std::move(image);
+		for (uint32_t page : dirty) {
+			copies[page].reset();
+		}
+		dirty.clear();
+		for (uint32_t page = 0; page < pages.size(); page++) {
+			pages[page] = this->image->Data() + (page << PAGE_SHIFT);
+		}
+		Reset();
+	}
+
+	uint8_t* Machine::CopyPage(uint32_t page) {
+		copies[page].reset(new uint8_t[PAGE_SIZE]);
+		memcpy(copies[page].get(), pages[page], PAGE_SIZE);
+		pages[page] = copies[page].get();
+		dirty.push_back(page);
+		return copies[page].get();
+	}
+
+	void Machine::Reset() {
+		state = MachineState::RUNNING;
+		memset(v, 0, sizeof(v));
+		i = 0;
+		pc = START_ADDRESS;
+		sp = 0;
+		dt = 0;
+		st = 0;
+		memset(stack, 0, sizeof(stack));
+		keys = 0;
+		waitRegister = 0;
+		planes = 1;
+		memset(rpl, 0, sizeof(rpl));
+		memset(pattern, 0, sizeof(pattern));
+		pitch = 64;
+		random = 0x2545F491;
+		display.SetHighRes(false);
+	}
+
+	void Machine::Seed(uint32_t seed) {
+		/* xorshift never leaves 0 */
+		random = seed != 0 ? seed : 0x2545F491;
+	}
+
+	void Machine::TickTimers() {
+		if (dt > 0) dt--;
+		if (st > 0) st--;
+	}
+
+	void Machine::SetKey(uint8_t key, bool pressed) {
+		uint16_t bit = 1 << (key & 0xF);
+		if (pressed) {
+			keys |= bit;
+		}
+		else if (keys & bit) {
+			keys &= ~bit;
+			if (state == MachineState::WAITING_KEY) {
+				v[waitRegister] = key & 0xF;
+				state = MachineState::RUNNING;
+			}
+		}
+	}
+
+	uint16_t Machine::GetRegister(Register reg) const {
+		if (reg <= Register::VF) {
+			return v[(int)reg];
+		}
+		switch (reg) {
+			case Register::I: return i;
+			case Register::ST: return st;
+			case Register::DT: return dt;
+			case Register::PC: return pc;
+			case Register::SP: return sp;
+			default: {
+				throw std::runtime_error(Formatter() << "Attempted to get invalid register " << (int)reg);
+			}
+		}
+	}
+
+	void Machine::SetRegister(Register reg, uint16_t value) {
+		if (reg <= Register::VF) {
+			v[(int)reg] = (uint8_t)value;
+			return;
+		}
+		switch (reg) {
+			case Register::I: i = value; break;
+			case Register::ST: st = (uint8_t)value; break;
+			case Register::DT: dt = (uint8_t)value; break;
+			case Register::PC: pc = value & addressMask; break;
+			case Register::SP: sp = value % STACK_SIZE; break;
+			default: {
+				throw std::runtime_error(Formatter() << "Attempted to set invalid register " << (int)reg);
+			}
+		}
+	}
+
+}
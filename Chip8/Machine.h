@@ -0,0 +1,210 @@
+#pragma once
+
+#include "Register.h"
+#include "Framebuffer.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace chip8 {
+
+	enum class Variant {
+		CHIP8,
+		SCHIP,
+		XOCHIP,
+	};
+
+	/*
+	The behaviours the chip8 variants disagree on, as bit flags
+	*/
+	enum Quirk : uint32_t {
+		/* SHR/SHL shift Vx in place instead of shifting Vy into Vx */
+		QUIRK_SHIFT_VX = 1 << 0,
+		/* LD [I], Vx and LD Vx, [I] leave I unchanged instead of incrementing it */
+		QUIRK_LOAD_STORE_KEEP_I = 1 << 1,
+		/* Bxnn jumps to xnn + Vx instead of xnn + V0 */
+		QUIRK_JUMP_VX = 1 << 2,
+		/* OR, AND and XOR reset VF to 0 */
+		QUIRK_VF_RESET = 1 << 3,
+		/* sprites wrap around the screen edges instead of being clipped */
+		QUIRK_WRAP = 1 << 4,
+	};
+
+	/* the amount of quirks, every combination gets its own execution core */
+	static const uint32_t QUIRK_COUNT = 5;
+	static const uint32_t QUIRK_ALL = (1 << QUIRK_COUNT) - 1;
+
+	/*
+	Return the quirks the given variant is usually run with
+	*/
+	uint32_t DefaultQuirks(Variant variant);
+
+	enum class MachineState {
+		RUNNING,
+		/* blocked on LD Vx, K until a key is released */
+		WAITING_KEY,
+		/* EXIT was executed */
+		HALTED,
+		/* stopped by an attached debugger */
+		BREAK,
+	};
+
+	/*
+	An immutable memory image holding the fonts and a rom, any amount
+	of machines can share one image and only copy the pages they write to
+	*/
+	class MemoryImage {
+	public:
+		/*
+		will throw an exception if the rom does not fit in the variant's memory
+		*/
+		MemoryImage(Variant variant, const uint8_t* rom = nullptr, size_t size = 0);
+
+		inline Variant GetVariant() const { return variant; }
+		inline uint32_t Size() const { return (uint32_t)bytes.size(); }
+		inline const uint8_t* Data() const { return bytes.data(); }
+
+	private:
+		Variant variant;
+		std::vector<uint8_t> bytes;
+
+	};
+
+	/*
+	The state of a single chip8 machine, everything the execution core
+	needs to run a rom, but not the execution core itself
+	*/
+	class Machine {
+	public:
+		static const uint16_t FONT_ADDRESS = 0x000;
+		static const uint16_t HFONT_ADDRESS = 0x050;
+		static const uint16_t START_ADDRESS = 0x200;
+		static const int STACK_SIZE = 16;
+		/* memory is copied on write in pages of this size */
+		static const int PAGE_SHIFT = 8;
+		static const uint32_t PAGE_SIZE = 1 << PAGE_SHIFT;
+
+		Machine(Variant variant = Variant::CHIP8);
+		Machine(Variant variant, uint32_t quirks);
+		Machine(std::shared_ptr<const MemoryImage> image, uint32_t quirks);
+
+		/*
+		Will reset the machine and load the rom at START_ADDRESS
+
+		will throw an exception if the rom does not fit in memory
+		*/
+		void LoadRom(const uint8_t* rom, size_t size);
+
+		/*
+		Will reset the machine and share the given image as its memory,
+		dropping every page it wrote to
+
+		will throw an exception if the image is for another variant
+		*/
+		void Load(std::shared_ptr<const MemoryImage> image);
+
+		/*
+		Will reset the registers, timers and display, the memory is left untouched
+		*/
+		void Reset();
+
+		/*
+		Will seed the generator used by RND, Reset restores the default seed
+		*/
+		void Seed(uint32_t seed);
+
+		/*
+		Will decrement the timers, should be called at 60hz
+		*/
+		void TickTimers();
+
+		/*
+		Will set the state of a key, releasing a key resumes a machine
+		that is waiting on LD Vx, K
+		*/
+		void SetKey(uint8_t key, bool pressed);
+
+		/*
+		Read and write any register, including I, the timers, PC and SP
+
+		will throw an exception on an invalid register
+		*/
+		uint16_t GetRegister(Register reg) const;
+		void SetRegister(Register reg, uint16_t value);
+
+		inline Variant GetVariant() const { return variant; }
+		inline uint32_t GetQuirks() const { return quirks; }
+		inline void SetQuirks(uint32_t quirks) { this->quirks = quirks & QUIRK_ALL; }
+		inline MachineState GetState() const { return state; }
+		inline uint16_t GetKeys() const { return keys; }
+		inline uint32_t MemorySize() const { return image->Size(); }
+		inline const MemoryImage& Image() const { return *image; }
+
+		/*
+		Read and write a byte of memory, the address wraps around the memory size
+		*/
+		inline uint8_t Read(uint32_t address) const {
+			address &= addressMask;
+			return pages[address >> PAGE_SHIFT][address & (PAGE_SIZE - 1)];
+		}
+
+		inline void Write(uint32_t address, uint8_t value) {
+			address &= addressMask;
+			uint8_t* page = copies[address >> PAGE_SHIFT].get();
+			if (page == nullptr) {
+				page = CopyPage(address >> PAGE_SHIFT);
+			}
+			page[address & (PAGE_SIZE - 1)] = value;
+		}
+
+		/*
+		Return the amount of pages this machine has its own copy of
+		*/
+		inline size_t DirtyPages() const { return dirty.size(); }
+		inline Framebuffer& Display() { return display; }
+		inline const Framebuffer& Display() const { return display; }
+		inline const uint8_t* AudioPattern() const { return pattern; }
+		inline uint8_t AudioPitch() const { return pitch; }
+		inline uint8_t Planes() const { return planes; }
+
+	private:
+		friend class Interpreter;
+		friend class Debugger;
+
+		uint8_t* CopyPage(uint32_t page);
+
+		Variant variant;
+		uint32_t quirks;
+		MachineState state;
+
+		uint8_t v[16];
+		uint16_t i;
+		uint16_t pc;
+		uint8_t sp;
+		uint8_t dt;
+		uint8_t st;
+		uint16_t stack[STACK_SIZE];
+
+		uint16_t keys;
+		uint8_t waitRegister;
+
+		uint8_t planes;
+		uint8_t rpl[16];
+		uint8_t pattern[16];
+		uint8_t pitch;
+		uint32_t random;
+
+		std::shared_ptr<const MemoryImage> image;
+		/* where every page is read from, the shared image until the page is written */
+		std::vector<const uint8_t*> pages;
+		/* the private copy of every written page, null while the page is shared */
+		std::vector<std::unique_ptr<uint8_t[]>> copies;
+		std::vector<uint32_t> dirty;
+		uint16_t addressMask;
+		Framebuffer display;
+
+	};
+
+}
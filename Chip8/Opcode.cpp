@@ -1,10 +1,36 @@
 #include "Opcode.h"
 
 #include "Util.h"
+#include "Format.h"
 #include "Formatter.h"
+#include "Statistics.h"
+
+#include <algorithm>
 
 namespace chip8 {
 
+	/*
+	Invalid words are common when decoding data as code, so the message
+	is built on the stack instead of through a stream
+	*/
+	[[noreturn]] static void ThrowInvalid(uint8_t prefix, int suffix) {
+		static const char PREFIX[] = "Invalid opcode [prefix=";
+		static const char SUFFIX[] = ", suffix=";
+		Statistics::Count(Counter::INVALID_OPCODES);
+
+		char message[64];
+		char* end = message + sizeof(message) - 2;
+		char* ptr = std::copy(PREFIX, PREFIX + sizeof(PREFIX) - 1, message);
+		ptr = ToChars(ptr, end, prefix, 16).ptr;
+		if (suffix >= 0) {
+			ptr = std::copy(SUFFIX, SUFFIX + sizeof(SUFFIX) - 1, ptr);
+			ptr = ToChars(ptr, end, (uint32_t)suffix, 16).ptr;
+		}
+		*ptr++ = ']';
+		*ptr = '\0';
+		throw std::runtime_error(message);
+	}
+
 	Opcode::Opcode(uint16_t bin, bool bigEndian) 
 		: type(OpcodeType::NONE)
 		, op1()
@@ -15,75 +41,120 @@ namespace chip8 {
 			if (!bigEndian) {
 				bin = ToBigEndian(bin);
 			}
+			Disassemble(bin);
+		}
+	}
 
-			switch (bin) {
-				case 0x00E0: type = OpcodeType::CLS; break;
-				case 0x00EE: type = OpcodeType::RET; break;
-				default: {
-					uint8_t opcodePrefix = bin >> 12;
-					switch (opcodePrefix) {
-						case 0x0: DisassembleImm(OpcodeType::SYS, bin, true); break;
-						case 0x1: DisassembleImm(OpcodeType::JP, bin, true); break;
-						case 0x2: DisassembleImm(OpcodeType::CALL, bin, true); break;
-						case 0x3: DisassembleRegImm(OpcodeType::SE, bin); break;
-						case 0x4: DisassembleRegImm(OpcodeType::SNE, bin); break;
-						case 0x5: DisassembleRegReg(OpcodeType::SE, bin); break;
-						case 0x6: DisassembleRegImm(OpcodeType::LD, bin); break;
-						case 0x7: DisassembleRegImm(OpcodeType::ADD, bin); break;
-						case 0x8: {
-							uint8_t suffix = bin & 0xF;
-							switch (suffix) {
-								case 0x0: DisassembleRegReg(OpcodeType::LD, bin); break;
-								case 0x1: DisassembleRegReg(OpcodeType::OR, bin); break;
-								case 0x2: DisassembleRegReg(OpcodeType::AND, bin); break;
-								case 0x3: DisassembleRegReg(OpcodeType::XOR, bin); break;
-								case 0x4: DisassembleRegReg(OpcodeType::ADD, bin); break;
-								case 0x5: DisassembleRegReg(OpcodeType::SUB, bin); break;
-								case 0x6: DisassembleReg(OpcodeType::SHR, bin); break;
-								case 0x7: DisassembleRegReg(OpcodeType::SUBN, bin); break;
-								case 0xe: DisassembleReg(OpcodeType::SHL, bin);  op1 = Operand((Register)((bin >> 8) | 0xF)); break;
-								default: {
-									throw std::runtime_error(Formatter() << "Invalid opcode [prefix=" << std::hex << (int)opcodePrefix << ", suffix=" << std::hex << (int)suffix << "]");
-								} break;
+	Opcode::Opcode(uint16_t bin, uint16_t ext, bool bigEndian)
+		: Opcode(bin, bigEndian)
+	{
+		if (type == OpcodeType::LD_LONG) {
+			if (!bigEndian) {
+				ext = ToBigEndian(ext);
+			}
+			op2 = Operand(ext, false, true);
+		}
+	}
+
+	void Opcode::Disassemble(uint16_t bin) {
+		Statistics::Count(Counter::DECODES);
+		switch (bin) {
+			case 0x00E0: type = OpcodeType::CLS; break;
+			case 0x00EE: type = OpcodeType::RET; break;
+			case 0x00FB: type = OpcodeType::SCR; break;
+			case 0x00FC: type = OpcodeType::SCL; break;
+			case 0x00FD: type = OpcodeType::EXIT; break;
+			case 0x00FE: type = OpcodeType::LOW; break;
+			case 0x00FF: type = OpcodeType::HIGH; break;
+			/* the address is filled by the constructor which gets the next word */
+			case 0xF000: type = OpcodeType::LD_LONG; op1 = Operand(Register::I); op2 = Operand(0, false, true); break;
+			case 0xF002: type = OpcodeType::AUDIO; break;
+			default: {
+				uint8_t opcodePrefix = bin >> 12;
+				switch (opcodePrefix) {
+					case 0x0: {
+						switch (bin & 0xFFF0) {
+							case 0x00C0: type = OpcodeType::SCD; op1 = Operand(bin & 0xF); break;
+							case 0x00D0: type = OpcodeType::SCU; op1 = Operand(bin & 0xF); break;
+							default: DisassembleImm(OpcodeType::SYS, bin, true); break;
+						}
+					} break;
+					case 0x1: DisassembleImm(OpcodeType::JP, bin, true); break;
+					case 0x2: DisassembleImm(OpcodeType::CALL, bin, true); break;
+					case 0x3: DisassembleRegImm(OpcodeType::SE, bin); break;
+					case 0x4: DisassembleRegImm(OpcodeType::SNE, bin); break;
+					case 0x5: {
+						uint8_t suffix = bin & 0xF;
+						switch (suffix) {
+							case 0x0: DisassembleRegReg(OpcodeType::SE, bin); break;
+							case 0x2: DisassembleRegReg(OpcodeType::SAVE, bin); break;
+							case 0x3: DisassembleRegReg(OpcodeType::LOAD, bin); break;
+							default: {
+								ThrowInvalid(opcodePrefix, suffix);
 							}
-						} break;
-						case 0x9: DisassembleRegReg(OpcodeType::SNE, bin); break;
-						case 0xa: DisassembleImm(OpcodeType::LD, bin); op2 = op1; op1 = Operand(Register::I); break;
-						case 0xb: DisassembleImm(OpcodeType::JP_V0, bin); break;
-						case 0xc: DisassembleRegImm(OpcodeType::RND, bin); break;
-						case 0xd: DisassembleRegRegImm(OpcodeType::DRW, bin); break;
-						case 0xe: {
-							uint8_t suffix = bin & 0xFF;
-							switch (suffix) {
-								case 0x9e: DisassembleReg(OpcodeType::SKP, bin); break;
-								case 0xa1: DisassembleReg(OpcodeType::SKNP, bin); break;
-								default: {
-									throw std::runtime_error(Formatter() << "Invalid opcode [prefix=" << std::hex << (int)opcodePrefix << ", suffix=" << std::hex << (int)suffix << "]");
-								}
+						}
+					} break;
+					case 0x6: DisassembleRegImm(OpcodeType::LD, bin); break;
+					case 0x7: DisassembleRegImm(OpcodeType::ADD, bin); break;
+					case 0x8: {
+						uint8_t suffix = bin & 0xF;
+						switch (suffix) {
+							case 0x0: DisassembleRegReg(OpcodeType::LD, bin); break;
+							case 0x1: DisassembleRegReg(OpcodeType::OR, bin); break;
+							case 0x2: DisassembleRegReg(OpcodeType::AND, bin); break;
+							case 0x3: DisassembleRegReg(OpcodeType::XOR, bin); break;
+							case 0x4: DisassembleRegReg(OpcodeType::ADD, bin); break;
+							case 0x5: DisassembleRegReg(OpcodeType::SUB, bin); break;
+							case 0x6: DisassembleRegReg(OpcodeType::SHR, bin); break;
+							case 0x7: DisassembleRegReg(OpcodeType::SUBN, bin); break;
+							case 0xe: DisassembleRegReg(OpcodeType::SHL, bin); break;
+							default: {
+								ThrowInvalid(opcodePrefix, suffix);
+							} break;
+						}
+					} break;
+					case 0x9: DisassembleRegReg(OpcodeType::SNE, bin); break;
+					case 0xa: DisassembleImm(OpcodeType::LD, bin, true); op2 = op1; op1 = Operand(Register::I); break;
+					case 0xb: DisassembleImm(OpcodeType::JP_V0, bin, true); break;
+					case 0xc: DisassembleRegImm(OpcodeType::RND, bin); break;
+					case 0xd: DisassembleRegRegImm(OpcodeType::DRW, bin); break;
+					case 0xe: {
+						uint8_t suffix = bin & 0xFF;
+						switch (suffix) {
+							case 0x9e: DisassembleReg(OpcodeType::SKP, bin); break;
+							case 0xa1: DisassembleReg(OpcodeType::SKNP, bin); break;
+							default: {
+								ThrowInvalid(opcodePrefix, suffix);
 							}
-						} break;
-						case 0xf: {
-							uint8_t suffix = bin & 0xFF;
-							switch (suffix) {
-								case 0x07: DisassembleReg(OpcodeType::LD, bin); op2 = Operand(Register::DT); break;
-								case 0x15: DisassembleReg(OpcodeType::LD, bin); op2 = op1; op1 = Operand(Register::DT); break;
-								case 0x18: DisassembleReg(OpcodeType::LD, bin); op2 = op1; op1 = Operand(Register::ST); break;
-								case 0x1e: DisassembleReg(OpcodeType::ADD, bin);  op2 = op1; op1 = Operand(Register::I); break;
-								case 0x29: DisassembleReg(OpcodeType::LD_FONT, bin); break;
-								case 0x33: DisassembleReg(OpcodeType::LD_BCD, bin); break;
-								case 0x55: DisassembleReg(OpcodeType::LD, bin, true); op2 = op1; op1 = Operand(Register::I); break;
-								case 0x65: DisassembleReg(OpcodeType::LD, bin, false); op2 = Operand(Register::I, true); break;
-								default: {
-									throw std::runtime_error(Formatter() << "Invalid opcode [prefix=" << std::hex << (int)opcodePrefix << ", suffix=" << std::hex << (int)suffix << "]");
-								}
+						}
+					} break;
+					case 0xf: {
+						uint8_t suffix = bin & 0xFF;
+						switch (suffix) {
+							case 0x07: DisassembleReg(OpcodeType::LD, bin); op2 = Operand(Register::DT); break;
+							case 0x0a: DisassembleReg(OpcodeType::LD_KEY, bin); break;
+							case 0x15: DisassembleReg(OpcodeType::LD, bin); op2 = op1; op1 = Operand(Register::DT); break;
+							case 0x18: DisassembleReg(OpcodeType::LD, bin); op2 = op1; op1 = Operand(Register::ST); break;
+							case 0x1e: DisassembleReg(OpcodeType::ADD, bin);  op2 = op1; op1 = Operand(Register::I); break;
+							case 0x01: type = OpcodeType::PLANE; op1 = Operand((bin >> 8) & 0xF); break;
+							case 0x29: DisassembleReg(OpcodeType::LD_FONT, bin); break;
+							case 0x30: DisassembleReg(OpcodeType::LD_HFONT, bin); break;
+							case 0x33: DisassembleReg(OpcodeType::LD_BCD, bin); break;
+							case 0x3a: DisassembleReg(OpcodeType::PITCH, bin); break;
+							case 0x55: DisassembleReg(OpcodeType::LD, bin); op2 = op1; op1 = Operand(Register::I, true); break;
+							case 0x65: DisassembleReg(OpcodeType::LD, bin, false); op2 = Operand(Register::I, true); break;
+							case 0x75: DisassembleReg(OpcodeType::LD_RPL_STORE, bin); break;
+							case 0x85: DisassembleReg(OpcodeType::LD_RPL_LOAD, bin); break;
+							default: {
+								ThrowInvalid(opcodePrefix, suffix);
 							}
-						} break;
-						default: {
-							throw std::runtime_error(Formatter() << "Invalid opcode [prefix=" << std::hex << (int)opcodePrefix << "]");
-						};
-					}
-				} break;
-			}
+						}
+					} break;
+					default: {
+						ThrowInvalid(opcodePrefix, -1);
+					};
+				}
+			} break;
 		}
 	}
 
@@ -116,7 +187,7 @@ namespace chip8 {
 					case Register::ST: op1 = op2; opcode = AssembleReg(0xf, 0x18); op1 = op_temp; break;
 					case Register::I: {
 						if (op1.IsMemory()) {
-							opcode = AssembleReg(0xf, 0x55);
+							op1 = op2; opcode = AssembleReg(0xf, 0x55); op1 = op_temp;
 						}
 						else {
 							op1 = op2; opcode = AssembleImm(0xa); op1 = op_temp;
@@ -158,9 +229,9 @@ namespace chip8 {
 			case OpcodeType::AND: opcode = AssembleRegReg(0x8, 0x2); break;
 			case OpcodeType::XOR: opcode = AssembleRegReg(0x8, 0x3); break;
 			case OpcodeType::SUB: opcode = AssembleRegReg(0x8, 0x5); break;
-			case OpcodeType::SHR: opcode = AssembleReg(0x8, 0x06); break;
+			case OpcodeType::SHR: opcode = AssembleRegReg(0x8, 0x6); break;
 			case OpcodeType::SUBN: opcode = AssembleRegReg(0x8, 0x7); break;
-			case OpcodeType::SHL: opcode = AssembleReg(0x8, 0x0e); break;
+			case OpcodeType::SHL: opcode = AssembleRegReg(0x8, 0xe); break;
 			case OpcodeType::JP_V0: opcode = AssembleImm(0xb); break;
 			case OpcodeType::RND: opcode = AssembleRegImm(0xc); break;
 			case OpcodeType::DRW: opcode = AssembleRegRegImm(0xd); break;
@@ -168,6 +239,23 @@ namespace chip8 {
 			case OpcodeType::SKNP: opcode = AssembleReg(0xe, 0xa1); break;
 			case OpcodeType::LD_FONT: opcode = AssembleReg(0xf, 0x29); break;
 			case OpcodeType::LD_BCD: opcode = AssembleReg(0xf, 0x33); break;
+			case OpcodeType::LD_KEY: opcode = AssembleReg(0xf, 0x0a); break;
+			case OpcodeType::SCD: opcode = 0x00C0 | (op1.AsImmediate() & 0xF); break;
+			case OpcodeType::SCR: opcode = 0x00FB; break;
+			case OpcodeType::SCL: opcode = 0x00FC; break;
+			case OpcodeType::EXIT: opcode = 0x00FD; break;
+			case OpcodeType::LOW: opcode = 0x00FE; break;
+			case OpcodeType::HIGH: opcode = 0x00FF; break;
+			case OpcodeType::LD_HFONT: opcode = AssembleReg(0xf, 0x30); break;
+			case OpcodeType::LD_RPL_STORE: opcode = AssembleReg(0xf, 0x75); break;
+			case OpcodeType::LD_RPL_LOAD: opcode = AssembleReg(0xf, 0x85); break;
+			case OpcodeType::SCU: opcode = 0x00D0 | (op1.AsImmediate() & 0xF); break;
+			case OpcodeType::SAVE: opcode = AssembleRegReg(0x5, 0x2); break;
+			case OpcodeType::LOAD: opcode = AssembleRegReg(0x5, 0x3); break;
+			case OpcodeType::LD_LONG: opcode = 0xF000; break;
+			case OpcodeType::PLANE: opcode = 0xF001 | ((op1.AsImmediate() & 0xF) << 8); break;
+			case OpcodeType::AUDIO: opcode = 0xF002; break;
+			case OpcodeType::PITCH: opcode = AssembleReg(0xf, 0x3a); break;
 		};
 
 		if (binEndian) {
@@ -177,6 +265,17 @@ namespace chip8 {
 		return opcode;
 	}
 	
+	uint16_t Opcode::AssembleExtension(bool bigEndian) const {
+		if (type != OpcodeType::LD_LONG) {
+			throw std::runtime_error(Formatter() << "Attempted to assemble the extension word of " << type);
+		}
+		uint16_t ext = op2.AsImmediate();
+		if (bigEndian) {
+			ext = ToBigEndian(ext);
+		}
+		return ext;
+	}
+
 	uint16_t Opcode::AssembleImm(uint8_t opcode) const {
 		return ((opcode & 0xF) << 12) | (op1.AsImmediate() & 0xFFF);
 	}
@@ -186,7 +285,7 @@ namespace chip8 {
 	}
 
 	uint16_t Opcode::AssembleRegImm(uint8_t opcode) const {
-		return ((opcode & 0xF) << 12) | ((uint16_t)(op1.AsRegister(true)) << 8) | (op2.AsImmediate() & 0xF);
+		return ((opcode & 0xF) << 12) | ((uint16_t)(op1.AsRegister(true)) << 8) | (op2.AsImmediate() & 0xFF);
 	}
 
 	uint16_t Opcode::AssembleRegReg(uint8_t opcode, uint8_t func) const {
@@ -210,7 +309,7 @@ namespace chip8 {
 	void Opcode::DisassembleRegImm(OpcodeType type, uint16_t opcode) {
 		this->type = type;
 		this->op1 = Operand((Register)((opcode >> 8) & 0xF));
-		this->op2 = Operand((opcode >> 4) & 0xFF);
+		this->op2 = Operand(opcode & 0xFF);
 	}
 
 	void Opcode::DisassembleRegReg(OpcodeType type, uint16_t opcode) {
@@ -227,86 +326,15 @@ namespace chip8 {
 	}
 
 	std::ostream& operator<<(std::ostream& out, OpcodeType op) {
-		switch (op) {
-			case OpcodeType::SYS: out << "SYS"; break;
-			case OpcodeType::CLS: out << "CLS"; break;
-			case OpcodeType::RET: out << "RET"; break;
-			case OpcodeType::JP_V0:
-			case OpcodeType::JP: out << "JP"; break;
-			case OpcodeType::CALL: out << "CALL"; break;
-			case OpcodeType::SE: out << "SE"; break;
-			case OpcodeType::SNE: out << "SNE"; break;
-			case OpcodeType::LD_FONT:
-			case OpcodeType::LD_BCD:
-			case OpcodeType::LD: out << "LD"; break;
-			case OpcodeType::ADD: out << "ADD"; break;
-			case OpcodeType::OR: out << "OR"; break;
-			case OpcodeType::AND: out << "AND"; break;
-			case OpcodeType::XOR: out << "XOR"; break;
-			case OpcodeType::SUB: out << "SUB"; break;
-			case OpcodeType::SHR: out << "SHR"; break;
-			case OpcodeType::SUBN: out << "SUBN"; break;
-			case OpcodeType::SHL: out << "SHL"; break;
-			case OpcodeType::RND: out << "RND"; break;
-			case OpcodeType::DRW: out << "DRW"; break;
-			case OpcodeType::SKP: out << "SKP"; break;
-			case OpcodeType::SKNP: out << "SKNP"; break;
-			default:
-				out << "<Invalid opcode>"; break;
-		}
-		return out;
+		char text[MAX_OPCODE_CHARS];
+		FormatResult result = ToChars(text, text + sizeof(text), op);
+		return out.write(text, result.ptr - text);
 	}
 
 	std::ostream& operator<<(std::ostream& out, Opcode op) {
-		out << op.type;
-		switch (op.type) {
-			case OpcodeType::SYS:
-			case OpcodeType::CALL:
-			case OpcodeType::JP:
-			case OpcodeType::SKP:
-			case OpcodeType::SKNP: {
-				out << op.op1;
-			} break;
-			case OpcodeType::XOR:
-			case OpcodeType::AND:
-			case OpcodeType::OR:
-			case OpcodeType::ADD:
-			case OpcodeType::SUB:
-			case OpcodeType::SHR:
-			case OpcodeType::SUBN:
-			case OpcodeType::SHL:
-			case OpcodeType::RND:
-			case OpcodeType::LD:
-			case OpcodeType::SE:
-			case OpcodeType::SNE: {
-				out << op.op1;
-				std::cout << ", ";
-				out << op.op2;
-			} break;
-			case OpcodeType::JP_V0: {
-				out << Operand(Register::V0);
-				std::cout << ", ";
-				out << op.op1;
-			} break;
-			case OpcodeType::LD_FONT: {
-				out << "F";
-				out << ", ";
-				out << op.op1;
-			} break;
-			case OpcodeType::LD_BCD: {
-				out << "B";
-				out << ",";
-				out << op.op1;
-			} break;
-			case OpcodeType::DRW: {
-				out << op.op1;
-				std::cout << ", ";
-				out << op.op2;
-				std::cout << ", ";
-				out << op.op3;
-			} break;
-		}
-		return out;
+		char text[MAX_OPCODE_CHARS];
+		FormatResult result = ToChars(text, text + sizeof(text), op);
+		return out.write(text, result.ptr - text);
 	}
 
 }
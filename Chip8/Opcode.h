@@ -42,6 +42,31 @@ namespace chip8 {
 		*/
 		LD_FONT,
 		LD_BCD,
+		LD_KEY,
+
+		/* SUPER-CHIP extensions */
+		SCD,
+		SCR,
+		SCL,
+		EXIT,
+		LOW,
+		HIGH,
+		LD_HFONT,
+		LD_RPL_STORE,
+		LD_RPL_LOAD,
+
+		/* XO-CHIP extensions */
+		SCU,
+		SAVE,
+		LOAD,
+		/*
+		LD I, <16bit addr>, the only instruction
+		that is 4 bytes long
+		*/
+		LD_LONG,
+		PLANE,
+		AUDIO,
+		PITCH,
 	};
 
 	std::ostream& operator<<(std::ostream& out, OpcodeType op);
@@ -62,6 +87,13 @@ namespace chip8 {
 		*/
 		Opcode(uint16_t bin = 0, bool bigEndian = false);
 
+		/*
+		same as above, but also takes the word following the instruction,
+		which is used as the address of the 4 byte LD I, <long> instruction
+		and ignored by everything else
+		*/
+		Opcode(uint16_t bin, uint16_t ext, bool bigEndian = false);
+
 		inline OpcodeType& Type() { return type; }
 		inline Operand& Operand1() { return op1; }
 		inline Operand& Operand2() { return op2; }
@@ -72,6 +104,11 @@ namespace chip8 {
 		inline Operand Operand2() const { return op2; }
 		inline Operand Operand3() const { return op3; }
 
+		/*
+		The size of the instruction in bytes
+		*/
+		inline uint8_t Length() const { return type == OpcodeType::LD_LONG ? 4 : 2; }
+
 		/* 
 		will assemble this instruction 
 		if bigEndian is true, will convert to big endian, otherwise
@@ -79,6 +116,12 @@ namespace chip8 {
 		*/
 		uint16_t Assemble(bool bigEndian = true);
 
+		/*
+		will assemble the second word of a 4 byte instruction,
+		should only be called if Length() is 4
+		*/
+		uint16_t AssembleExtension(bool bigEndian = true) const;
+
 	private:
 		/* The different layouts that can be assembled */
 		uint16_t AssembleImm(uint8_t opcode) const;
@@ -93,6 +136,7 @@ namespace chip8 {
 		void DisassembleRegImm(OpcodeType type, uint16_t opcode);
 		void DisassembleRegReg(OpcodeType type, uint16_t opcode);
 		void DisassembleRegRegImm(OpcodeType type, uint16_t opcode);
+		void Disassemble(uint16_t bin);
 
 		/*
 		Will print the opcode
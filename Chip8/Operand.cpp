@@ -1,8 +1,8 @@
 #include "Operand.h"
 
 #include <sstream>
-#include <iomanip>
 
+#include "Format.h"
 #include "Formatter.h"
 
 namespace chip8 {
@@ -59,28 +59,9 @@ namespace chip8 {
 	}
 
 	std::ostream& operator<<(std::ostream& out, const Operand& op) {
-		if (op.mem) {
-			out << "[";
-		}
-		switch (op.type) {
-			case OperandType::REGISTER: {
-				out << op.reg;
-			} break;
-			case OperandType::IMMEDIATE: {
-				if (op.addr) {
-					out << std::setfill('0') << std::setw(3) << std::hex << op.imm;
-				}
-				else {
-					out << op.imm;
-				}
-			} break;
-		}
-		if (op.mem) {
-			out << "]";
-		}
-
-		return out;
+		char text[16];
+		FormatResult result = ToChars(text, text + sizeof(text), op);
+		return out.write(text, result.ptr - text);
 	}
 
-
 }
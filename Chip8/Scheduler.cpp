@@ -0,0 +1,265 @@
+#include "Scheduler.h"
+
+#include "Formatter.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace chip8 {
+
+	Scheduler::Job::Job(std::shared_ptr<const MemoryImage> image, uint32_t quirks, const Options& options)
+		: machine(image, quirks)
+		, interpreter(machine)
+		, options(options)
+		, id(0)
+		, cancel(false)
+		, state(JobState::QUEUED)
+		, frames(0)
+		, instructions(0)
+		, error()
+		, audio()
+		, wav()
+	{
+		if (!options.wavPath.empty()) {
+			audio.reset(new Audio());
+			wav.reset(new WavWriter(options.wavPath, audio->SampleRate()));
+		}
+	}
+
+	Scheduler::Scheduler(uint32_t threads, uint32_t sliceFrames)
+		: sliceFrames(std::max(1u, sliceFrames))
+		, nextWorker(0)
+		, pending(0)
+		, sleeping(0)
+		, stopping(false)
+		, unfinished(0)
+		, started(false)
+	{
+		if (threads == 0) {
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		}
+		for (uint32_t t = 0; t < threads; t++) {
+			workers.emplace_back(new Worker());
+			workers.back()->frames = 0;
+			workers.back()->instructions = 0;
+		}
+		for (uint32_t t = 0; t < threads; t++) {
+			this->threads.emplace_back(&Scheduler::Run, this, t);
+		}
+	}
+
+	Scheduler::~Scheduler() {
+		{
+			std::lock_guard<std::mutex> guard(jobsLock);
+			for (auto& job : jobs) {
+				job->cancel = true;
+			}
+		}
+		Wait();
+		{
+			std::lock_guard<std::mutex> guard(sleepLock);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+	}
+
+	uint32_t Scheduler::Submit(std::shared_ptr<const MemoryImage> image, uint32_t quirks, const Options& options) {
+		std::unique_ptr<Job> job(new Job(image, quirks, options));
+		Job* queued = job.get();
+		uint32_t worker;
+		{
+			std::lock_guard<std::mutex> guard(jobsLock);
+			job->id = (uint32_t)jobs.size();
+			jobs.push_back(std::move(job));
+			worker = nextWorker;
+			nextWorker = (nextWorker + 1) % workers.size();
+		}
+		{
+			std::lock_guard<std::mutex> guard(doneLock);
+			if (!started) {
+				started = true;
+				startTime = std::chrono::steady_clock::now();
+			}
+			unfinished++;
+		}
+		Push(worker, queued);
+		return queued->id;
+	}
+
+	void Scheduler::Cancel(uint32_t job) {
+		std::lock_guard<std::mutex> guard(jobsLock);
+		if (job >= jobs.size()) {
+			throw std::runtime_error(Formatter() << "Attempted to cancel unknown job " << job);
+		}
+		jobs[job]->cancel = true;
+	}
+
+	void Scheduler::Wait() {
+		std::unique_lock<std::mutex> guard(doneLock);
+		done.wait(guard, [this]() { return unfinished == 0; });
+	}
+
+	const Scheduler::Job& Scheduler::GetJob(uint32_t job) const {
+		std::lock_guard<std::mutex> guard(jobsLock);
+		if (job >= jobs.size()) {
+			throw std::runtime_error(Formatter() << "Unknown job " << job);
+		}
+		return *jobs[job];
+	}
+
+	JobState Scheduler::GetState(uint32_t job) const {
+		return GetJob(job).state;
+	}
+
+	uint64_t Scheduler::GetFrames(uint32_t job) const {
+		const Job& j = GetJob(job);
+		return j.state != JobState::QUEUED ? j.frames : 0;
+	}
+
+	uint64_t Scheduler::GetInstructions(uint32_t job) const {
+		const Job& j = GetJob(job);
+		return j.state != JobState::QUEUED ? j.instructions : 0;
+	}
+
+	std::string Scheduler::GetError(uint32_t job) const {
+		const Job& j = GetJob(job);
+		return j.state != JobState::QUEUED ? j.error : std::string();
+	}
+
+	const Machine& Scheduler::GetMachine(uint32_t job) const {
+		return GetJob(job).machine;
+	}
+
+	Scheduler::Report Scheduler::GetReport() const {
+		Report report = { 0, 0, 0 };
+		for (const auto& worker : workers) {
+			report.frames += worker->frames.load(std::memory_order_relaxed);
+			report.instructions += worker->instructions.load(std::memory_order_relaxed);
+		}
+		std::lock_guard<std::mutex> guard(doneLock);
+		if (started) {
+			auto end = unfinished == 0 ? endTime : std::chrono::steady_clock::now();
+			report.seconds = std::chrono::duration<double>(end - startTime).count();
+		}
+		return report;
+	}
+
+	void Scheduler::Push(uint32_t index, Job* job) {
+		Worker& worker = *workers[index];
+		{
+			std::lock_guard<std::mutex> guard(worker.lock);
+			worker.queues[(size_t)job->options.priority].push_back(job);
+		}
+		pending++;
+		if (sleeping > 0) {
+			std::lock_guard<std::mutex> guard(sleepLock);
+			wake.notify_one();
+		}
+	}
+
+	Scheduler::Job* Scheduler::Take(uint32_t index) {
+		size_t count = workers.size();
+		for (int priority = (int)JobPriority::COUNT - 1; priority >= 0; priority--) {
+			/* the own queue first, taking the job that waited longest */
+			{
+				Worker& own = *workers[index];
+				std::lock_guard<std::mutex> guard(own.lock);
+				std::deque<Job*>& queue = own.queues[priority];
+				if (!queue.empty()) {
+					Job* job = queue.front();
+					queue.pop_front();
+					pending--;
+					return job;
+				}
+			}
+			/* then steal from the back of the others */
+			for (size_t k = 1; k < count; k++) {
+				Worker& victim = *workers[(index + k) % count];
+				std::lock_guard<std::mutex> guard(victim.lock);
+				std::deque<Job*>& queue = victim.queues[priority];
+				if (!queue.empty()) {
+					Job* job = queue.back();
+					queue.pop_back();
+					pending--;
+					return job;
+				}
+			}
+		}
+		return nullptr;
+	}
+
+	void Scheduler::Run(uint32_t index) {
+		Worker& worker = *workers[index];
+		while (true) {
+			Job* job = Take(index);
+			if (job == nullptr) {
+				std::unique_lock<std::mutex> guard(sleepLock);
+				sleeping++;
+				wake.wait(guard, [this]() { return pending > 0 || stopping; });
+				sleeping--;
+				if (stopping && pending == 0) {
+					return;
+				}
+				continue;
+			}
+
+			if (job->cancel) {
+				Finish(*job, JobState::CANCELLED);
+				continue;
+			}
+			RunSlice(worker, *job);
+			if (job->state == JobState::QUEUED) {
+				Push(index, job);
+			}
+		}
+	}
+
+	void Scheduler::RunSlice(Worker& worker, Job& job) {
+		uint64_t frames = std::min<uint64_t>(sliceFrames, job.options.frames - job.frames);
+		uint64_t instructions = 0;
+		uint64_t frame = 0;
+		try {
+			for (; frame < frames && job.machine.GetState() == MachineState::RUNNING; frame++) {
+				instructions += job.interpreter.Run(job.options.cyclesPerFrame);
+				if (job.wav != nullptr) {
+					size_t count = job.audio->RenderFrame(job.machine);
+					job.wav->Write(job.audio->Samples(), count);
+				}
+				job.machine.TickTimers();
+			}
+		}
+		catch (const std::runtime_error& e) {
+			job.error = e.what();
+		}
+		job.frames += frame;
+		job.instructions += instructions;
+		worker.frames.fetch_add(frame, std::memory_order_relaxed);
+		worker.instructions.fetch_add(instructions, std::memory_order_relaxed);
+
+		if (!job.error.empty()) {
+			Finish(job, JobState::FAILED);
+		}
+		else if (job.machine.GetState() == MachineState::WAITING_KEY) {
+			Finish(job, JobState::WAITING_KEY);
+		}
+		else if (job.frames >= job.options.frames || job.machine.GetState() == MachineState::HALTED) {
+			Finish(job, JobState::FINISHED);
+		}
+	}
+
+	void Scheduler::Finish(Job& job, JobState state) {
+		if (job.wav != nullptr) {
+			job.wav->Close();
+		}
+		job.state = state;
+		std::lock_guard<std::mutex> guard(doneLock);
+		if (--unfinished == 0) {
+			endTime = std::chrono::steady_clock::now();
+			done.notify_all();
+		}
+	}
+
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include "Audio.h"
+#include "Machine.h"
+#include "Interpreter.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace chip8 {
+
+	enum class JobPriority {
+		LOW,
+		NORMAL,
+		HIGH,
+
+		COUNT
+	};
+
+	enum class JobState {
+		QUEUED,
+		/* ran its whole budget or halted */
+		FINISHED,
+		CANCELLED,
+		/* stopped by an invalid opcode or a stack error */
+		FAILED,
+		/* stopped on LD Vx, K, jobs have no keypad so the key would never come */
+		WAITING_KEY,
+	};
+
+	/*
+	Runs many machines, each with its own rom and budget, on a pool of threads
+
+	machines are run in slices of a few frames, after a slice a machine goes
+	back to the queue of the thread that ran it, threads that run out of work
+	steal from the other queues, so short and long running roms mix without
+	leaving threads idle
+
+	a queued higher priority machine always runs before a lower priority one,
+	and a machine that starts waiting for a key is retired instead of queued again
+	*/
+	class Scheduler {
+	public:
+		struct Options {
+			/* the amount of frames to run, the job finishes early if the machine halts */
+			uint64_t frames = 60;
+			uint32_t cyclesPerFrame = 15;
+			JobPriority priority = JobPriority::NORMAL;
+			/* if not empty, the sound of every frame is recorded into this WAV file */
+			std::string wavPath;
+		};
+
+		struct Report {
+			uint64_t frames;
+			uint64_t instructions;
+			/* the wall time from the first submitted job until now, or until the last job finished */
+			double seconds;
+
+			inline double InstructionsPerSecond() const { return seconds > 0 ? instructions / seconds : 0; }
+		};
+
+		/*
+		threads 0 uses every core, sliceFrames is the amount of frames a machine
+		runs before it goes back to the queue
+		*/
+		Scheduler(uint32_t threads = 0, uint32_t sliceFrames = 16);
+		Scheduler(const Scheduler&) = delete;
+		Scheduler& operator=(const Scheduler&) = delete;
+
+		/*
+		Will cancel every job that has not finished and stop the threads
+		*/
+		~Scheduler();
+
+		/*
+		Will queue a new machine running the given image, returns the id of the job
+
+		will throw an exception if the WAV file can not be created
+		*/
+		uint32_t Submit(std::shared_ptr<const MemoryImage> image, uint32_t quirks, const Options& options);
+
+		/*
+		Will stop a job the next time it would run a slice
+		*/
+		void Cancel(uint32_t job);
+
+		/*
+		Will block until every submitted job is done
+		*/
+		void Wait();
+
+		/*
+		Return the state of a job, and once it is done, the frames and
+		instructions it ran and the error that stopped it
+
+		will throw an exception on an unknown job
+		*/
+		JobState GetState(uint32_t job) const;
+		uint64_t GetFrames(uint32_t job) const;
+		uint64_t GetInstructions(uint32_t job) const;
+		std::string GetError(uint32_t job) const;
+
+		/*
+		Return the machine of a job, only safe to use once the job is done
+		*/
+		const Machine& GetMachine(uint32_t job) const;
+
+		Report GetReport() const;
+
+	private:
+		struct Job {
+			Job(std::shared_ptr<const MemoryImage> image, uint32_t quirks, const Options& options);
+
+			Machine machine;
+			Interpreter interpreter;
+			Options options;
+			uint32_t id;
+			std::atomic<bool> cancel;
+			std::atomic<JobState> state;
+			/* only touched by the thread running the job */
+			uint64_t frames;
+			uint64_t instructions;
+			std::string error;
+			/* only set when recording, the file is completed when the job is done */
+			std::unique_ptr<Audio> audio;
+			std::unique_ptr<WavWriter> wav;
+		};
+
+		/* the queues of a single thread, padded so threads do not share cache lines */
+		struct alignas(64) Worker {
+			std::mutex lock;
+			std::deque<Job*> queues[(size_t)JobPriority::COUNT];
+			std::atomic<uint64_t> frames;
+			std::atomic<uint64_t> instructions;
+		};
+
+		void Run(uint32_t index);
+		Job* Take(uint32_t index);
+		void Push(uint32_t index, Job* job);
+		void RunSlice(Worker& worker, Job& job);
+		void Finish(Job& job, JobState state);
+		const Job& GetJob(uint32_t job) const;
+
+		uint32_t sliceFrames;
+		std::vector<std::unique_ptr<Worker>> workers;
+		std::vector<std::thread> threads;
+
+		mutable std::mutex jobsLock;
+		std::vector<std::unique_ptr<Job>> jobs;
+		uint32_t nextWorker;
+
+		/* the amount of queued jobs, and of threads waiting for one */
+		std::atomic<int64_t> pending;
+		std::atomic<int32_t> sleeping;
+		std::atomic<bool> stopping;
+		std::mutex sleepLock;
+		std::condition_variable wake;
+
+		/* guarded by doneLock */
+		mutable std::mutex doneLock;
+		std::condition_variable done;
+		uint64_t unfinished;
+		bool started;
+		std::chrono::steady_clock::time_point startTime;
+		std::chrono::steady_clock::time_point endTime;
+
+	};
+
+}
@@ -0,0 +1,120 @@
+#include "Statistics.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace chip8 {
+
+	thread_local Statistics::Block* Statistics::local = nullptr;
+
+	/* the blocks of the live threads, and the totals of the threads that ended */
+	struct Registry {
+		std::mutex lock;
+		std::vector<Statistics::Block*> blocks;
+		Statistics::Snapshot retired = {};
+		Statistics::Snapshot baseline = {};
+
+		Statistics::Snapshot Total() const {
+			Statistics::Snapshot total = retired;
+			for (Statistics::Block* block : blocks) {
+				for (size_t k = 0; k < Statistics::COUNTERS; k++) {
+					total.counters[k] += block->counters[k].load(std::memory_order_relaxed);
+				}
+				for (size_t k = 0; k < Statistics::STAGES; k++) {
+					total.stages[k] += block->stages[k].load(std::memory_order_relaxed);
+				}
+			}
+			return total;
+		}
+	};
+
+	static Registry& GetRegistry() {
+		static Registry registry;
+		return registry;
+	}
+
+	/* hands the counts of a thread to the registry when the thread ends */
+	struct ThreadBlock {
+		Statistics::Block* block = nullptr;
+		~ThreadBlock() {
+			if (block != nullptr) {
+				Statistics::Detach(block);
+			}
+		}
+	};
+
+	Statistics::Block& Statistics::Attach() {
+		static thread_local ThreadBlock owner;
+
+		Block* block = new Block();
+		for (auto& value : block->counters) value.store(0, std::memory_order_relaxed);
+		for (auto& value : block->stages) value.store(0, std::memory_order_relaxed);
+
+		Registry& registry = GetRegistry();
+		{
+			std::lock_guard<std::mutex> guard(registry.lock);
+			registry.blocks.push_back(block);
+		}
+		owner.block = block;
+		local = block;
+		return *block;
+	}
+
+	void Statistics::Detach(Block* block) {
+		Registry& registry = GetRegistry();
+		std::lock_guard<std::mutex> guard(registry.lock);
+		for (size_t k = 0; k < COUNTERS; k++) {
+			registry.retired.counters[k] += block->counters[k].load(std::memory_order_relaxed);
+		}
+		for (size_t k = 0; k < STAGES; k++) {
+			registry.retired.stages[k] += block->stages[k].load(std::memory_order_relaxed);
+		}
+		registry.blocks.erase(std::remove(registry.blocks.begin(), registry.blocks.end(), block), registry.blocks.end());
+		local = nullptr;
+		delete block;
+	}
+
+	Statistics::Snapshot Statistics::Read() {
+		Registry& registry = GetRegistry();
+		std::lock_guard<std::mutex> guard(registry.lock);
+		Snapshot total = registry.Total();
+		for (size_t k = 0; k < COUNTERS; k++) {
+			total.counters[k] -= registry.baseline.counters[k];
+		}
+		for (size_t k = 0; k < STAGES; k++) {
+			total.stages[k] -= registry.baseline.stages[k];
+		}
+		return total;
+	}
+
+	void Statistics::Reset() {
+		/* the blocks belong to their threads, so only the baseline moves */
+		Registry& registry = GetRegistry();
+		std::lock_guard<std::mutex> guard(registry.lock);
+		registry.baseline = registry.Total();
+	}
+
+	const char* Statistics::Name(Counter counter) {
+		switch (counter) {
+			case Counter::DECODES: return "decodes";
+			case Counter::INVALID_OPCODES: return "invalid opcodes";
+			case Counter::CACHE_HITS: return "cache hits";
+			case Counter::CACHE_MISSES: return "cache misses";
+			case Counter::BLOCKS_DISCOVERED: return "blocks discovered";
+			case Counter::BYTES_EMITTED: return "bytes emitted";
+			default: return "<invalid counter>";
+		}
+	}
+
+	const char* Statistics::Name(Stage stage) {
+		switch (stage) {
+			case Stage::READ: return "read";
+			case Stage::ANALYSE: return "analyse";
+			case Stage::FORMAT: return "format";
+			default: return "<invalid stage>";
+		}
+	}
+
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+namespace chip8 {
+
+	enum class Counter : uint32_t {
+		/* words run through the decoder */
+		DECODES,
+		/* words the decoder rejected */
+		INVALID_OPCODES,
+		/* lookups that found an already decoded block, in the Analysis or the Interpreter */
+		CACHE_HITS,
+		CACHE_MISSES,
+		/* blocks the Analysis decoded */
+		BLOCKS_DISCOVERED,
+		/* bytes of text written by the tools */
+		BYTES_EMITTED,
+
+		COUNT
+	};
+
+	enum class Stage : uint32_t {
+		READ,
+		ANALYSE,
+		FORMAT,
+
+		COUNT
+	};
+
+	/*
+	Counts what the library does, every thread counts into its own block
+	without any synchronization, the blocks are only added up when the
+	statistics are read
+	*/
+	class Statistics {
+	public:
+		static const size_t COUNTERS = (size_t)Counter::COUNT;
+		static const size_t STAGES = (size_t)Stage::COUNT;
+
+		struct Snapshot {
+			uint64_t counters[COUNTERS];
+			/* the wall time spent in each stage, in nanoseconds */
+			uint64_t stages[STAGES];
+		};
+
+		/*
+		Adds the time between its construction and destruction to a stage
+		*/
+		class Timer {
+		public:
+			inline Timer(Stage stage) : stage(stage), start(std::chrono::steady_clock::now()) {}
+			inline ~Timer() {
+				AddTime(stage, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+			}
+			Timer(const Timer&) = delete;
+			Timer& operator=(const Timer&) = delete;
+
+		private:
+			Stage stage;
+			std::chrono::steady_clock::time_point start;
+		};
+
+		static inline void Count(Counter counter, uint64_t n = 1) {
+			Add(Local().counters[(size_t)counter], n);
+		}
+
+		static inline void AddTime(Stage stage, uint64_t nanoseconds) {
+			Add(Local().stages[(size_t)stage], nanoseconds);
+		}
+
+		/*
+		Return the totals of every thread since the last Reset
+		*/
+		static Snapshot Read();
+
+		/*
+		Will start counting from zero again
+		*/
+		static void Reset();
+
+		static const char* Name(Counter counter);
+		static const char* Name(Stage stage);
+
+	private:
+		struct Block {
+			std::atomic<uint64_t> counters[COUNTERS];
+			std::atomic<uint64_t> stages[STAGES];
+		};
+
+		/* only the owning thread writes, so a plain load and store is enough */
+		static inline void Add(std::atomic<uint64_t>& value, uint64_t n) {
+			value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+		}
+
+		static inline Block& Local() {
+			Block* block = local;
+			return block != nullptr ? *block : Attach();
+		}
+
+		static Block& Attach();
+		static void Detach(Block* block);
+
+		static thread_local Block* local;
+
+		friend struct Registry;
+		friend struct ThreadBlock;
+
+	};
+
+}
@@ -0,0 +1,200 @@
+#include "ValueSet.h"
+
+#include <algorithm>
+
+namespace chip8 {
+
+	ValueSet::ValueSet()
+		: bits{ 0, 0, 0, 0 }
+	{
+	}
+
+	ValueSet ValueSet::Of(uint8_t value) {
+		ValueSet set;
+		set.Insert(value);
+		return set;
+	}
+
+	ValueSet ValueSet::All() {
+		ValueSet set;
+		std::fill(set.bits, set.bits + 4, ~0ull);
+		return set;
+	}
+
+	ValueSet ValueSet::Range(uint8_t first, uint8_t last) {
+		ValueSet set;
+		for (uint32_t value = first; value <= last; value++) {
+			set.Insert((uint8_t)value);
+		}
+		return set;
+	}
+
+	uint32_t ValueSet::Count() const {
+		uint32_t count = 0;
+		for (uint64_t word : bits) {
+			for (; word != 0; word &= word - 1) {
+				count++;
+			}
+		}
+		return count;
+	}
+
+	uint8_t ValueSet::Min() const {
+		for (uint32_t value = 0; value < 256; value++) {
+			if (Contains((uint8_t)value)) return (uint8_t)value;
+		}
+		return 0;
+	}
+
+	uint8_t ValueSet::Max() const {
+		for (uint32_t value = 256; value-- > 0;) {
+			if (Contains((uint8_t)value)) return (uint8_t)value;
+		}
+		return 0;
+	}
+
+	bool ValueSet::Join(const ValueSet& other) {
+		bool grown = false;
+		for (uint32_t word = 0; word < 4; word++) {
+			uint64_t joined = bits[word] | other.bits[word];
+			grown |= joined != bits[word];
+			bits[word] = joined;
+		}
+		return grown;
+	}
+
+	ValueSet ValueSet::Offset(uint8_t amount) const {
+		if (amount == 0 || IsAll()) {
+			return *this;
+		}
+		ValueSet set;
+		ForEach([&](uint8_t value) { set.Insert((uint8_t)(value + amount)); });
+		return set;
+	}
+
+	AddressSet::AddressSet()
+		: intervals()
+		, count(0)
+	{
+	}
+
+	AddressSet AddressSet::Of(uint16_t address) {
+		return Range(address, address);
+	}
+
+	AddressSet AddressSet::All() {
+		return Range(0, 0xFFFF);
+	}
+
+	AddressSet AddressSet::Range(uint16_t first, uint16_t last) {
+		AddressSet set;
+		if (first <= last) {
+			set.Add(first, last);
+		}
+		return set;
+	}
+
+	bool AddressSet::Contains(uint16_t address) const {
+		for (uint32_t k = 0; k < count; k++) {
+			if (intervals[k].first <= address && address <= intervals[k].last) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	uint32_t AddressSet::Count() const {
+		uint32_t total = 0;
+		for (uint32_t k = 0; k < count; k++) {
+			total += intervals[k].last - intervals[k].first + 1;
+		}
+		return total;
+	}
+
+	bool AddressSet::Join(const AddressSet& other) {
+		if (other.IsEmpty()) {
+			return false;
+		}
+		AddressSet joined = *this;
+		other.ForEach([&](uint16_t first, uint16_t last) { joined.Add(first, last); });
+		joined.Normalize();
+		/* the joined set holds every address of this one, so it grew if it changed */
+		bool grown = joined != *this;
+		*this = joined;
+		return grown;
+	}
+
+	AddressSet AddressSet::Offset(uint16_t amount) const {
+		if (IsEmpty()) {
+			return *this;
+		}
+		if (Last() + (uint32_t)amount > 0xFFFF) {
+			return All();
+		}
+		AddressSet set = *this;
+		for (uint32_t k = 0; k < count; k++) {
+			set.intervals[k].first += amount;
+			set.intervals[k].last += amount;
+		}
+		return set;
+	}
+
+	AddressSet AddressSet::Offset(const ValueSet& values) const {
+		if (IsEmpty() || values.IsEmpty()) {
+			return AddressSet();
+		}
+		uint8_t min = values.Min();
+		uint8_t max = values.Max();
+		if (Last() + (uint32_t)max > 0xFFFF) {
+			return All();
+		}
+		AddressSet set;
+		ForEach([&](uint16_t first, uint16_t last) { set.Add(first + min, last + max); });
+		set.Normalize();
+		return set;
+	}
+
+	bool AddressSet::operator==(const AddressSet& other) const {
+		if (count != other.count) {
+			return false;
+		}
+		for (uint32_t k = 0; k < count; k++) {
+			if (intervals[k].first != other.intervals[k].first || intervals[k].last != other.intervals[k].last) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void AddressSet::Add(uint32_t first, uint32_t last) {
+		intervals[count++] = { first, last };
+	}
+
+	void AddressSet::Normalize() {
+		std::sort(intervals, intervals + count, [](const Interval& a, const Interval& b) { return a.first < b.first; });
+
+		uint32_t merged = 0;
+		for (uint32_t k = 0; k < count; k++) {
+			if (merged > 0 && intervals[k].first <= intervals[merged - 1].last + 1) {
+				intervals[merged - 1].last = std::max(intervals[merged - 1].last, intervals[k].last);
+			}
+			else {
+				intervals[merged++] = intervals[k];
+			}
+		}
+		count = merged;
+
+		while (count > MAX_INTERVALS) {
+			uint32_t closest = 0;
+			for (uint32_t k = 1; k + 1 < count; k++) {
+				if (intervals[k + 1].first - intervals[k].last < intervals[closest + 1].first - intervals[closest].last) {
+					closest = k;
+				}
+			}
+			intervals[closest].last = intervals[closest + 1].last;
+			std::copy(intervals + closest + 2, intervals + count, intervals + closest + 1);
+			count--;
+		}
+	}
+
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstdint>
+
+namespace chip8 {
+
+	/*
+	The values an 8 bit register may hold at some point of a program,
+	kept exactly as one bit per value
+	*/
+	class ValueSet {
+	public:
+		/* the empty set */
+		ValueSet();
+
+		static ValueSet Of(uint8_t value);
+		static ValueSet All();
+		/* every value from first up to and including last */
+		static ValueSet Range(uint8_t first, uint8_t last);
+
+		inline bool Contains(uint8_t value) const { return ((bits[value >> 6] >> (value & 63)) & 1) != 0; }
+		inline void Insert(uint8_t value) { bits[value >> 6] |= 1ull << (value & 63); }
+		inline void Erase(uint8_t value) { bits[value >> 6] &= ~(1ull << (value & 63)); }
+
+		uint32_t Count() const;
+		inline bool IsEmpty() const { return (bits[0] | bits[1] | bits[2] | bits[3]) == 0; }
+		inline bool IsAll() const { return (bits[0] & bits[1] & bits[2] & bits[3]) == ~0ull; }
+
+		/*
+		Return the smallest and largest value, 0 if the set is empty
+		*/
+		uint8_t Min() const;
+		uint8_t Max() const;
+
+		/*
+		Will add every value of the other set, return if this set grew
+		*/
+		bool Join(const ValueSet& other);
+
+		/*
+		Return every value plus the given amount, wrapping around like the registers do
+		*/
+		ValueSet Offset(uint8_t amount) const;
+
+		/*
+		Will call f with every value, in ascending order
+		*/
+		template <typename F>
+		void ForEach(F f) const {
+			for (uint32_t word = 0; word < 4; word++) {
+				uint64_t rest = bits[word];
+				while (rest != 0) {
+					uint32_t bit = 0;
+					while (((rest >> bit) & 1) == 0) bit++;
+					rest &= rest - 1;
+					f((uint8_t)(word * 64 + bit));
+				}
+			}
+		}
+
+		inline bool operator==(const ValueSet& other) const {
+			return bits[0] == other.bits[0] && bits[1] == other.bits[1] && bits[2] == other.bits[2] && bits[3] == other.bits[3];
+		}
+		inline bool operator!=(const ValueSet& other) const { return !(*this == other); }
+
+	private:
+		uint64_t bits[4];
+
+	};
+
+	/*
+	The addresses I may hold at some point of a program, I is 16 bits
+	wide so this is kept as a few intervals instead of exactly, past
+	MAX_INTERVALS the closest ones are merged
+	*/
+	class AddressSet {
+	public:
+		static const uint32_t MAX_INTERVALS = 8;
+
+		/* the empty set */
+		AddressSet();
+
+		static AddressSet Of(uint16_t address);
+		static AddressSet All();
+		/* every address from first up to and including last */
+		static AddressSet Range(uint16_t first, uint16_t last);
+
+		inline bool IsEmpty() const { return count == 0; }
+		inline bool IsAll() const { return count == 1 && intervals[0].first == 0 && intervals[0].last == 0xFFFF; }
+		bool Contains(uint16_t address) const;
+		/* the amount of addresses, 0 if the set is empty */
+		uint32_t Count() const;
+		/* the smallest and largest address, only meaningful if the set is not empty */
+		inline uint16_t First() const { return (uint16_t)intervals[0].first; }
+		inline uint16_t Last() const { return (uint16_t)intervals[count - 1].last; }
+
+		/*
+		Will add every address of the other set, return if this set grew
+		*/
+		bool Join(const AddressSet& other);
+
+		/*
+		Return every sum of an address and the given amount or one of the given
+		values, the set becomes every address if a sum can wrap around
+		*/
+		AddressSet Offset(uint16_t amount) const;
+		AddressSet Offset(const ValueSet& values) const;
+
+		/*
+		Will call f with the first and last address of every interval, in ascending order
+		*/
+		template <typename F>
+		void ForEach(F f) const {
+			for (uint32_t k = 0; k < count; k++) {
+				f((uint16_t)intervals[k].first, (uint16_t)intervals[k].last);
+			}
+		}
+
+		bool operator==(const AddressSet& other) const;
+		inline bool operator!=(const AddressSet& other) const { return !(*this == other); }
+
+	private:
+		struct Interval {
+			uint32_t first;
+			uint32_t last;
+		};
+
+		/*
+		Will add an interval, it is only sorted and merged by Normalize
+		*/
+		void Add(uint32_t first, uint32_t last);
+		/*
+		Will sort the intervals, merge the ones that overlap or touch,
+		and merge the closest ones until at most MAX_INTERVALS are left
+		*/
+		void Normalize();
+
+		/* room for the intervals of two sets before they are normalized */
+		Interval intervals[MAX_INTERVALS * 2];
+		uint32_t count;
+
+	};
+
+}
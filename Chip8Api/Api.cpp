@@ -0,0 +1,332 @@
+#include "chip8.h"
+
+#include "Format.h"
+#include "Interpreter.h"
+#include "Machine.h"
+#include "Opcode.h"
+#include "Statistics.h"
+
+#include <cstring>
+#include <exception>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+using namespace chip8;
+
+static_assert((int)OpcodeType::NONE == CHIP8_OP_NONE, "chip8_opcode_type is out of sync with OpcodeType");
+static_assert((int)OpcodeType::PITCH == CHIP8_OP_PITCH, "chip8_opcode_type is out of sync with OpcodeType");
+static_assert((int)Register::COUNT == CHIP8_REGISTER_COUNT, "CHIP8_REGISTER_COUNT is out of sync with Register");
+
+struct chip8_machine {
+	chip8_machine(std::shared_ptr<const MemoryImage> image, uint32_t quirks)
+		: machine(image, quirks)
+		, interpreter(machine)
+	{
+	}
+
+	Machine machine;
+	Interpreter interpreter;
+};
+
+static thread_local std::string lastError;
+
+static int Fail(int status, const char* message) {
+	lastError = message;
+	return status;
+}
+
+static void SetKeys(Machine& machine, uint16_t keys) {
+	uint16_t changed = machine.GetKeys() ^ keys;
+	for (uint8_t key = 0; changed != 0; key++, changed >>= 1) {
+		if (changed & 1) {
+			machine.SetKey(key, (keys >> key) & 1);
+		}
+	}
+}
+
+static chip8_operand ToOperand(const Operand& op) {
+	chip8_operand result = { CHIP8_OPERAND_NONE, 0, 0 };
+	switch (op.GetType()) {
+		case OperandType::NONE: {
+			result.kind = CHIP8_OPERAND_NONE;
+		} break;
+		case OperandType::REGISTER: {
+			result.kind = CHIP8_OPERAND_REGISTER;
+			result.value = (uint16_t)op.AsRegister();
+		} break;
+		case OperandType::IMMEDIATE: {
+			result.kind = CHIP8_OPERAND_IMMEDIATE;
+			result.value = op.AsImmediate();
+		} break;
+	}
+	result.flags = (op.IsMemory() ? CHIP8_OPERAND_MEMORY : 0) | (op.IsAddress() ? CHIP8_OPERAND_ADDRESS : 0);
+	return result;
+}
+
+static Operand FromOperand(const chip8_operand& op) {
+	switch (op.kind) {
+		case CHIP8_OPERAND_REGISTER: return Operand((Register)op.value, (op.flags & CHIP8_OPERAND_MEMORY) != 0);
+		case CHIP8_OPERAND_IMMEDIATE: return Operand(op.value, (op.flags & CHIP8_OPERAND_MEMORY) != 0, (op.flags & CHIP8_OPERAND_ADDRESS) != 0);
+		default: return Operand();
+	}
+}
+
+extern "C" {
+
+	const char* chip8_status_string(int status) {
+		switch (status) {
+			case CHIP8_OK: return "ok";
+			case CHIP8_ERROR_INVALID_ARGUMENT: return "invalid argument";
+			case CHIP8_ERROR_INVALID_OPCODE: return "invalid opcode";
+			case CHIP8_ERROR_ROM_TOO_LARGE: return "rom too large";
+			case CHIP8_ERROR_STACK: return "stack overflow or underflow";
+			case CHIP8_ERROR_BUFFER_TOO_SMALL: return "buffer too small";
+			case CHIP8_ERROR_OUT_OF_MEMORY: return "out of memory";
+			case CHIP8_ERROR_INTERNAL: return "internal error";
+			default: return "unknown status";
+		}
+	}
+
+	const char* chip8_last_error(void) {
+		return lastError.c_str();
+	}
+
+	int chip8_decode(const uint8_t* bytes, size_t size, uint16_t base,
+		chip8_instruction* out, size_t capacity, size_t* decoded)
+	{
+		if ((bytes == nullptr && size > 0) || (out == nullptr && capacity > 0) || decoded == nullptr) {
+			return Fail(CHIP8_ERROR_INVALID_ARGUMENT, "null buffer");
+		}
+
+		size_t n = 0;
+		size_t offset = 0;
+		while (offset + 2 <= size && n < capacity) {
+			chip8_instruction& ins = out[n++];
+			memset(&ins, 0, sizeof(ins));
+			ins.address = (uint16_t)(base + offset);
+			ins.word = (uint16_t)((bytes[offset] << 8) | bytes[offset + 1]);
+			ins.length = 2;
+
+			uint16_t ext = offset + 4 <= size ? (uint16_t)((bytes[offset + 2] << 8) | bytes[offset + 3]) : 0;
+			try {
+				Opcode opcode(ins.word, ext, true);
+				ins.type = (uint8_t)opcode.Type();
+				ins.length = opcode.Length();
+				ins.operands[0] = ToOperand(opcode.Operand1());
+				ins.operands[1] = ToOperand(opcode.Operand2());
+				ins.operands[2] = ToOperand(opcode.Operand3());
+			}
+			catch (const std::runtime_error&) {
+				ins.type = CHIP8_OP_INVALID;
+			}
+			offset += ins.length;
+		}
+		*decoded = n;
+		return CHIP8_OK;
+	}
+
+	int chip8_format(const chip8_instruction* instructions, size_t count,
+		char* text, size_t capacity, size_t* written)
+	{
+		if ((instructions == nullptr && count > 0) || (text == nullptr && capacity > 0) || written == nullptr) {
+			return Fail(CHIP8_ERROR_INVALID_ARGUMENT, "null buffer");
+		}
+
+		char* ptr = text;
+		char* last = text + capacity;
+		for (size_t k = 0; k < count; k++) {
+			const chip8_instruction& ins = instructions[k];
+			if (ins.type > CHIP8_OP_PITCH && ins.type != CHIP8_OP_INVALID) {
+				*written = ptr - text;
+				return Fail(CHIP8_ERROR_INVALID_ARGUMENT, "unknown opcode type");
+			}
+			/* an invalid word keeps the NONE type, which formats as an invalid opcode */
+			Opcode opcode;
+			if (ins.type != CHIP8_OP_INVALID) {
+				opcode.Type() = (OpcodeType)ins.type;
+			}
+			opcode.Operand1() = FromOperand(ins.operands[0]);
+			opcode.Operand2() = FromOperand(ins.operands[1]);
+			opcode.Operand3() = FromOperand(ins.operands[2]);
+
+			FormatResult result = ToChars(ptr, last, opcode);
+			if (result.overflow || result.ptr == last) {
+				*written = ptr - text;
+				return Fail(CHIP8_ERROR_BUFFER_TOO_SMALL, "text buffer too small");
+			}
+			*result.ptr++ = '\n';
+			ptr = result.ptr;
+		}
+		*written = ptr - text;
+		Statistics::Count(Counter::BYTES_EMITTED, *written);
+		return CHIP8_OK;
+	}
+
+	int chip8_machine_create(int variant, uint32_t quirks,
+		const uint8_t* rom, size_t size, chip8_machine** machine)
+	{
+		if (machine == nullptr || (rom == nullptr && size > 0) || variant < CHIP8_VARIANT_CHIP8 || variant > CHIP8_VARIANT_XOCHIP) {
+			return Fail(CHIP8_ERROR_INVALID_ARGUMENT, "invalid machine arguments");
+		}
+		*machine = nullptr;
+		try {
+			Variant v = (Variant)variant;
+			auto image = std::make_shared<MemoryImage>(v, rom, size);
+			*machine = new chip8_machine(image, quirks == CHIP8_DEFAULT_QUIRKS ? DefaultQuirks(v) : quirks);
+			return CHIP8_OK;
+		}
+		catch (const std::bad_alloc&) {
+			return Fail(CHIP8_ERROR_OUT_OF_MEMORY, "out of memory");
+		}
+		catch (const std::exception& e) {
+			return Fail(CHIP8_ERROR_ROM_TOO_LARGE, e.what());
+		}
+	}
+
+	void chip8_machine_destroy(chip8_machine* machine) {
+		delete machine;
+	}
+
+	int chip8_machine_load(chip8_machine* machine, const uint8_t* rom, size_t size) {
+		if (machine == nullptr || (rom == nullptr && size > 0)) {
+			return Fail(CHIP8_ERROR_INVALID_ARGUMENT, "invalid load arguments");
+		}
+		try {
+			machine->machine.LoadRom(rom, size);
+			machine->interpreter.Flush();
+			return CHIP8_OK;
+		}
+		catch (const std::bad_alloc&) {
+			return Fail(CHIP8_ERROR_OUT_OF_MEMORY, "out of memory");
+		}
+		catch (const std::exception& e) {
+			return Fail(CHIP8_ERROR_ROM_TOO_LARGE, e.what());
+		}
+	}
+
+	int chip8_machine_run(chip8_machine* machine, uint64_t cycles, uint64_t* executed) {
+		if (machine == nullptr) {
+			return Fail(CHIP8_ERROR_INVALID_ARGUMENT, "null machine");
+		}
+		try {
+			uint64_t n = machine->interpreter.Run(cycles);
+			if (executed != nullptr) {
+				*executed = n;
+			}
+			return CHIP8_OK;
+		}
+		catch (const std::bad_alloc&) {
+			return Fail(CHIP8_ERROR_OUT_OF_MEMORY, "out of memory");
+		}
+		catch (const StackError& e) {
+			return Fail(CHIP8_ERROR_STACK, e.what());
+		}
+		catch (const InvalidOpcodeError& e) {
+			return Fail(CHIP8_ERROR_INVALID_OPCODE, e.what());
+		}
+		catch (const std::exception& e) {
+			return Fail(CHIP8_ERROR_INTERNAL, e.what());
+		}
+	}
+
+	int chip8_machine_run_frames(chip8_machine* machine, uint32_t frames,
+		uint32_t cycles_per_frame, const uint16_t* keys, uint32_t* ran)
+	{
+		if (machine == nullptr) {
+			return Fail(CHIP8_ERROR_INVALID_ARGUMENT, "null machine");
+		}
+		uint32_t frame = 0;
+		int status = CHIP8_OK;
+		try {
+			for (; frame < frames && machine->machine.GetState() != MachineState::HALTED; frame++) {
+				if (keys != nullptr) {
+					SetKeys(machine->machine, keys[frame]);
+				}
+				machine->interpreter.RunFrame(cycles_per_frame);
+			}
+		}
+		catch (const std::bad_alloc&) {
+			status = Fail(CHIP8_ERROR_OUT_OF_MEMORY, "out of memory");
+		}
+		catch (const StackError& e) {
+			status = Fail(CHIP8_ERROR_STACK, e.what());
+		}
+		catch (const InvalidOpcodeError& e) {
+			status = Fail(CHIP8_ERROR_INVALID_OPCODE, e.what());
+		}
+		catch (const std::exception& e) {
+			status = Fail(CHIP8_ERROR_INTERNAL, e.what());
+		}
+		if (ran != nullptr) {
+			*ran = frame;
+		}
+		return status;
+	}
+
+	int chip8_machine_set_keys(chip8_machine* machine, uint16_t keys) {
+		if (machine == nullptr) {
+			return Fail(CHIP8_ERROR_INVALID_ARGUMENT, "null machine");
+		}
+		SetKeys(machine->machine, keys);
+		return CHIP8_OK;
+	}
+
+	int chip8_machine_get_state(const chip8_machine* machine, int* state) {
+		if (machine == nullptr || state == nullptr) {
+			return Fail(CHIP8_ERROR_INVALID_ARGUMENT, "null machine or state");
+		}
+		switch (machine->machine.GetState()) {
+			case MachineState::WAITING_KEY: *state = CHIP8_STATE_WAITING_KEY; break;
+			case MachineState::HALTED: *state = CHIP8_STATE_HALTED; break;
+			case MachineState::BREAK: *state = CHIP8_STATE_BREAK; break;
+			default: *state = CHIP8_STATE_RUNNING; break;
+		}
+		return CHIP8_OK;
+	}
+
+	int chip8_machine_registers(const chip8_machine* machine, uint16_t* out, size_t capacity) {
+		if (machine == nullptr || out == nullptr) {
+			return Fail(CHIP8_ERROR_INVALID_ARGUMENT, "null machine or buffer");
+		}
+		if (capacity < CHIP8_REGISTER_COUNT) {
+			return Fail(CHIP8_ERROR_BUFFER_TOO_SMALL, "register buffer too small");
+		}
+		for (int reg = 0; reg < CHIP8_REGISTER_COUNT; reg++) {
+			out[reg] = machine->machine.GetRegister((Register)reg);
+		}
+		return CHIP8_OK;
+	}
+
+	int chip8_machine_framebuffer(const chip8_machine* machine,
+		uint8_t* out, size_t capacity, uint32_t* width, uint32_t* height)
+	{
+		if (machine == nullptr || out == nullptr) {
+			return Fail(CHIP8_ERROR_INVALID_ARGUMENT, "null machine or buffer");
+		}
+		const Framebuffer& display = machine->machine.Display();
+		int w = display.Width();
+		int h = display.Height();
+		if (width != nullptr) *width = w;
+		if (height != nullptr) *height = h;
+		if (capacity < (size_t)(w * h)) {
+			return Fail(CHIP8_ERROR_BUFFER_TOO_SMALL, "framebuffer buffer too small");
+		}
+
+		memset(out, 0, w * h);
+		for (int plane = 0; plane < Framebuffer::MAX_PLANES; plane++) {
+			for (int y = 0; y < h; y++) {
+				const Framebuffer::Row& row = display.GetRow(plane, y);
+				uint8_t* line = out + y * w;
+				for (int x = 0; x < w && x < 64; x++) {
+					line[x] |= ((row.hi >> (63 - x)) & 1) << plane;
+				}
+				for (int x = 64; x < w; x++) {
+					line[x] |= ((row.lo >> (127 - x)) & 1) << plane;
+				}
+			}
+		}
+		return CHIP8_OK;
+	}
+
+}
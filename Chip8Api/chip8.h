@@ -0,0 +1,177 @@
+#pragma once
+
+/*
+The C interface of the chip8 library, for embedding it from other languages
+
+every call returns a chip8_status instead of throwing, and works on
+batches, so a single call can decode a whole rom or run many frames
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(CHIP8_API_EXPORTS)
+#define CHIP8_API __declspec(dllexport)
+#else
+#define CHIP8_API __declspec(dllimport)
+#endif
+#else
+#define CHIP8_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	typedef enum chip8_status {
+		CHIP8_OK = 0,
+		CHIP8_ERROR_INVALID_ARGUMENT = -1,
+		CHIP8_ERROR_INVALID_OPCODE = -2,
+		CHIP8_ERROR_ROM_TOO_LARGE = -3,
+		CHIP8_ERROR_STACK = -4,
+		CHIP8_ERROR_BUFFER_TOO_SMALL = -5,
+		CHIP8_ERROR_OUT_OF_MEMORY = -6,
+		CHIP8_ERROR_INTERNAL = -7,
+	} chip8_status;
+
+	typedef enum chip8_variant {
+		CHIP8_VARIANT_CHIP8 = 0,
+		CHIP8_VARIANT_SCHIP = 1,
+		CHIP8_VARIANT_XOCHIP = 2,
+	} chip8_variant;
+
+	/* pass as the quirks to use the variant's defaults */
+	#define CHIP8_DEFAULT_QUIRKS 0xFFFFFFFFu
+
+	/* the same values as chip8::OpcodeType, except CHIP8_OP_INVALID which has no counterpart */
+	typedef enum chip8_opcode_type {
+		CHIP8_OP_NONE = 0,
+		CHIP8_OP_SYS, CHIP8_OP_CLS, CHIP8_OP_RET, CHIP8_OP_JP, CHIP8_OP_CALL,
+		CHIP8_OP_SE, CHIP8_OP_SNE, CHIP8_OP_LD, CHIP8_OP_ADD, CHIP8_OP_OR,
+		CHIP8_OP_AND, CHIP8_OP_XOR, CHIP8_OP_SUB, CHIP8_OP_SHR, CHIP8_OP_SUBN,
+		CHIP8_OP_SHL, CHIP8_OP_JP_V0, CHIP8_OP_RND, CHIP8_OP_DRW, CHIP8_OP_SKP,
+		CHIP8_OP_SKNP, CHIP8_OP_LD_FONT, CHIP8_OP_LD_BCD, CHIP8_OP_LD_KEY,
+		CHIP8_OP_SCD, CHIP8_OP_SCR, CHIP8_OP_SCL, CHIP8_OP_EXIT, CHIP8_OP_LOW,
+		CHIP8_OP_HIGH, CHIP8_OP_LD_HFONT, CHIP8_OP_LD_RPL_STORE, CHIP8_OP_LD_RPL_LOAD,
+		CHIP8_OP_SCU, CHIP8_OP_SAVE, CHIP8_OP_LOAD, CHIP8_OP_LD_LONG, CHIP8_OP_PLANE,
+		CHIP8_OP_AUDIO, CHIP8_OP_PITCH,
+		/* a word that does not decode */
+		CHIP8_OP_INVALID = 0xFF,
+	} chip8_opcode_type;
+
+	typedef enum chip8_operand_kind {
+		CHIP8_OPERAND_NONE = 0,
+		CHIP8_OPERAND_REGISTER = 1,
+		CHIP8_OPERAND_IMMEDIATE = 2,
+	} chip8_operand_kind;
+
+	/* operand flags */
+	#define CHIP8_OPERAND_MEMORY 0x1
+	#define CHIP8_OPERAND_ADDRESS 0x2
+
+	typedef struct chip8_operand {
+		uint8_t kind;
+		uint8_t flags;
+		/* the register (same values as chip8::Register) or the immediate */
+		uint16_t value;
+	} chip8_operand;
+
+	typedef struct chip8_instruction {
+		uint16_t address;
+		uint16_t word;
+		/* a chip8_opcode_type, CHIP8_OP_INVALID if the word does not decode */
+		uint8_t type;
+		/* 2 or 4 bytes */
+		uint8_t length;
+		chip8_operand operands[3];
+	} chip8_instruction;
+
+	typedef enum chip8_machine_state {
+		CHIP8_STATE_RUNNING = 0,
+		CHIP8_STATE_WAITING_KEY = 1,
+		CHIP8_STATE_HALTED = 2,
+		/* stopped by an attached debugger */
+		CHIP8_STATE_BREAK = 3,
+	} chip8_machine_state;
+
+	/* the amount of registers read by chip8_machine_registers: V0-VF, I, ST, DT, PC, SP */
+	#define CHIP8_REGISTER_COUNT 21
+
+	typedef struct chip8_machine chip8_machine;
+
+	/*
+	Return a static description of a status
+	*/
+	CHIP8_API const char* chip8_status_string(int status);
+
+	/*
+	Return the message of the last failed call on this thread, empty if there was none
+	*/
+	CHIP8_API const char* chip8_last_error(void);
+
+	/*
+	Will decode the big endian code at address base, one instruction after the other,
+	until the bytes or the capacity run out, invalid words decode as CHIP8_OP_INVALID
+
+	decoded receives the amount of instructions written
+	*/
+	CHIP8_API int chip8_decode(const uint8_t* bytes, size_t size, uint16_t base,
+		chip8_instruction* out, size_t capacity, size_t* decoded);
+
+	/*
+	Will write the text of each instruction into text, one per line
+
+	written receives the amount of characters, the text is not null terminated,
+	returns CHIP8_ERROR_BUFFER_TOO_SMALL if not all the instructions fit
+	*/
+	CHIP8_API int chip8_format(const chip8_instruction* instructions, size_t count,
+		char* text, size_t capacity, size_t* written);
+
+	/*
+	Will create a machine with the rom loaded, quirks is a mask of chip8::Quirk
+	or CHIP8_DEFAULT_QUIRKS
+	*/
+	CHIP8_API int chip8_machine_create(int variant, uint32_t quirks,
+		const uint8_t* rom, size_t size, chip8_machine** machine);
+
+	CHIP8_API void chip8_machine_destroy(chip8_machine* machine);
+
+	/*
+	Will reset the machine and load another rom
+	*/
+	CHIP8_API int chip8_machine_load(chip8_machine* machine, const uint8_t* rom, size_t size);
+
+	/*
+	Will run up to cycles instructions, executed receives the amount that ran
+	*/
+	CHIP8_API int chip8_machine_run(chip8_machine* machine, uint64_t cycles, uint64_t* executed);
+
+	/*
+	Will run frames 60hz frames of cycles_per_frame instructions, holding the
+	given keys (bit n is key n) for each frame, keys may be null to hold none
+
+	ran receives the amount of frames that ran, it stops early if the machine halts
+	*/
+	CHIP8_API int chip8_machine_run_frames(chip8_machine* machine, uint32_t frames,
+		uint32_t cycles_per_frame, const uint16_t* keys, uint32_t* ran);
+
+	CHIP8_API int chip8_machine_set_keys(chip8_machine* machine, uint16_t keys);
+
+	CHIP8_API int chip8_machine_get_state(const chip8_machine* machine, int* state);
+
+	/*
+	Will read CHIP8_REGISTER_COUNT registers into out
+	*/
+	CHIP8_API int chip8_machine_registers(const chip8_machine* machine, uint16_t* out, size_t capacity);
+
+	/*
+	Will copy the display into out, one byte per pixel holding the plane bits,
+	row after row, width and height receive the size of the display
+	*/
+	CHIP8_API int chip8_machine_framebuffer(const chip8_machine* machine,
+		uint8_t* out, size_t capacity, uint32_t* width, uint32_t* height);
+
+#ifdef __cplusplus
+}
+#endif
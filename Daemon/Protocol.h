@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+The wire format of the daemon, every number is little endian
+
+a client sends any amount of requests without waiting, each one is a
+header followed by size bytes of payload, the daemon answers every
+request in order with a response header and payload that echo the tag
+
+requests that are already buffered are handled as one batch and their
+responses are sent back together, a failed request has an empty payload
+except a RUN that fails while running, which still reports how far it got
+*/
+namespace protocol {
+
+	static const uint32_t HEADER_SIZE = 12;
+	static const uint32_t MAX_PAYLOAD = 1 << 20;
+	/* the most a single RUN may ask for, larger requests are rejected as BAD_REQUEST */
+	static const uint32_t MAX_RUN_FRAMES = 60 * 60;
+	static const uint32_t MAX_CYCLES_PER_FRAME = 1 << 16;
+
+	/*
+	request:  u32 size, u8 command, u8[3] reserved, u32 tag
+	response: u32 size, u8 command, i8 status, u8[2] reserved, u32 tag
+	*/
+	enum Command : uint8_t {
+		/* u8 variant, u8[3] reserved, rom bytes -> u32 rom */
+		LOAD = 1,
+		/* u32 rom, u32 quirks (0xFFFFFFFF for the defaults) -> u32 machine */
+		OPEN = 2,
+		/* u32 machine -> nothing, the machine goes back to the rom's pool */
+		CLOSE = 3,
+		/* u32 machine, u16 keys -> nothing */
+		KEYS = 4,
+		/* u32 machine, u32 frames, u32 cycles per frame, optionally u16 keys for every frame -> u32 frames run, u8 state */
+		RUN = 5,
+		/* u32 machine -> u64 hash of the display */
+		HASH = 6,
+		/* u32 machine -> u16 for V0-VF, I, ST, DT, PC, SP */
+		REGISTERS = 7,
+		/* u32 machine -> nothing, the machine is reset to the rom */
+		RESET = 8,
+	};
+
+	enum Status : int8_t {
+		OK = 0,
+		BAD_REQUEST = -1,
+		UNKNOWN_HANDLE = -2,
+		ROM_TOO_LARGE = -3,
+		INVALID_OPCODE = -4,
+		STACK_ERROR = -5,
+		/* anything else that went wrong in the daemon, like running out of memory */
+		INTERNAL_ERROR = -6,
+	};
+
+}
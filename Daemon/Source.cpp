@@ -0,0 +1,497 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <afunix.h>
+typedef SOCKET Socket;
+#define closeSocket closesocket
+#else
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+typedef int Socket;
+static const Socket INVALID_SOCKET = -1;
+#define closeSocket close
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#include <Interpreter.h>
+#include <Machine.h>
+
+#include "Protocol.h"
+
+using namespace chip8;
+
+/* how many idle machines are kept warm for every rom */
+static const size_t MAX_POOL_SIZE = 256;
+static const size_t RECEIVE_SIZE = 64 * 1024;
+
+static uint32_t ReadU32(const uint8_t* p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t ReadU16(const uint8_t* p) {
+	return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static void WriteU16(std::vector<uint8_t>& out, uint16_t value) {
+	out.push_back((uint8_t)value);
+	out.push_back((uint8_t)(value >> 8));
+}
+
+static void WriteU32(std::vector<uint8_t>& out, uint32_t value) {
+	for (int k = 0; k < 4; k++) {
+		out.push_back((uint8_t)(value >> (k * 8)));
+	}
+}
+
+static void WriteU64(std::vector<uint8_t>& out, uint64_t value) {
+	WriteU32(out, (uint32_t)value);
+	WriteU32(out, (uint32_t)(value >> 32));
+}
+
+static uint64_t Hash(const uint8_t* bytes, size_t size, uint64_t hash = 0xCBF29CE484222325ull) {
+	for (size_t k = 0; k < size; k++) {
+		hash = (hash ^ bytes[k]) * 0x100000001B3ull;
+	}
+	return hash;
+}
+
+static uint64_t HashDisplay(const Framebuffer& display) {
+	uint8_t hires = display.IsHighRes() ? 1 : 0;
+	uint64_t hash = Hash(&hires, 1);
+	for (int plane = 0; plane < Framebuffer::MAX_PLANES; plane++) {
+		for (int y = 0; y < display.Height(); y++) {
+			const Framebuffer::Row& row = display.GetRow(plane, y);
+			hash = Hash((const uint8_t*)&row, sizeof(row), hash);
+		}
+	}
+	return hash;
+}
+
+static void SetKeys(Machine& machine, uint16_t keys) {
+	uint16_t changed = machine.GetKeys() ^ keys;
+	for (uint8_t key = 0; changed != 0; key++, changed >>= 1) {
+		if (changed & 1) {
+			machine.SetKey(key, (keys >> key) & 1);
+		}
+	}
+}
+
+/*
+A machine and its execution core, the interpreter keeps its decoded
+blocks while the instance goes in and out of its rom's pool
+*/
+struct Instance {
+	Instance(std::shared_ptr<const MemoryImage> image, uint32_t quirks)
+		: machine(image, quirks)
+		, interpreter(machine)
+	{
+	}
+
+	Machine machine;
+	Interpreter interpreter;
+	uint32_t rom;
+};
+
+/*
+The state shared by every connection, the loaded roms and their pools
+*/
+class Server {
+public:
+	Server() : nextRom(1) {}
+
+	/*
+	Will load a rom, or find the same rom loaded before
+	*/
+	uint32_t Load(Variant variant, const uint8_t* rom, size_t size) {
+		uint64_t hash = Hash(rom, size) ^ (uint64_t)variant;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			uint32_t known = FindLoaded(hash, variant, rom, size);
+			if (known != 0) {
+				return known;
+			}
+		}
+
+		std::unique_ptr<Rom> loaded(new Rom());
+		loaded->variant = variant;
+		loaded->image = std::make_shared<MemoryImage>(variant, rom, size);
+		loaded->bytes.assign(rom, rom + size);
+
+		std::lock_guard<std::mutex> guard(lock);
+		/* another connection may have loaded the same rom while the image was built */
+		uint32_t known = FindLoaded(hash, variant, rom, size);
+		if (known != 0) {
+			return known;
+		}
+		uint32_t id = nextRom++;
+		loaded->id = id;
+		roms[id] = std::move(loaded);
+		byHash.emplace(hash, id);
+		return id;
+	}
+
+	/*
+	Will take a warm machine from the rom's pool, or create one,
+	returns null if the rom is unknown
+	*/
+	std::unique_ptr<Instance> Open(uint32_t rom, uint32_t quirks) {
+		std::shared_ptr<const MemoryImage> image;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			auto it = roms.find(rom);
+			if (it == roms.end()) {
+				return nullptr;
+			}
+			image = it->second->image;
+			if (quirks == 0xFFFFFFFF) {
+				quirks = DefaultQuirks(it->second->variant);
+			}
+			if (!it->second->idle.empty()) {
+				std::unique_ptr<Instance> instance = std::move(it->second->idle.back());
+				it->second->idle.pop_back();
+				instance->machine.SetQuirks(quirks);
+				return instance;
+			}
+		}
+		std::unique_ptr<Instance> instance(new Instance(image, quirks));
+		instance->rom = rom;
+		return instance;
+	}
+
+	/*
+	Will reset a machine and put it back into its rom's pool
+	*/
+	void Close(std::unique_ptr<Instance> instance) {
+		std::shared_ptr<const MemoryImage> image;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			image = roms.at(instance->rom)->image;
+		}
+		instance->interpreter.Load(image);
+
+		std::lock_guard<std::mutex> guard(lock);
+		Rom& rom = *roms.at(instance->rom);
+		if (rom.idle.size() < MAX_POOL_SIZE) {
+			rom.idle.push_back(std::move(instance));
+		}
+	}
+
+	std::shared_ptr<const MemoryImage> Image(uint32_t rom) {
+		std::lock_guard<std::mutex> guard(lock);
+		return roms.at(rom)->image;
+	}
+
+private:
+	struct Rom {
+		uint32_t id;
+		Variant variant;
+		std::shared_ptr<const MemoryImage> image;
+		std::vector<uint8_t> bytes;
+		std::vector<std::unique_ptr<Instance>> idle;
+	};
+
+	/*
+	Return the id of the same rom loaded before, 0 if there is none,
+	the lock must be held
+	*/
+	uint32_t FindLoaded(uint64_t hash, Variant variant, const uint8_t* rom, size_t size) const {
+		auto range = byHash.equal_range(hash);
+		for (auto it = range.first; it != range.second; ++it) {
+			const Rom& known = *roms.at(it->second);
+			if (known.variant == variant && known.bytes.size() == size && std::equal(known.bytes.begin(), known.bytes.end(), rom)) {
+				return known.id;
+			}
+		}
+		return 0;
+	}
+
+	std::mutex lock;
+	uint32_t nextRom;
+	std::unordered_map<uint32_t, std::unique_ptr<Rom>> roms;
+	std::unordered_multimap<uint64_t, uint32_t> byHash;
+};
+
+/*
+A single client, its machines are only visible to it
+*/
+class Connection {
+public:
+	Connection(Server& server, Socket socket)
+		: server(server)
+		, socket(socket)
+		, nextMachine(1)
+	{
+	}
+
+	~Connection() {
+		for (auto& it : machines) {
+			server.Close(std::move(it.second));
+		}
+		closeSocket(socket);
+	}
+
+	void Serve() {
+		std::vector<uint8_t> in;
+		size_t used = 0;
+		while (true) {
+			if (in.size() - used < RECEIVE_SIZE) {
+				in.resize(used + RECEIVE_SIZE);
+			}
+			int received = recv(socket, (char*)in.data() + used, (int)(in.size() - used), 0);
+			if (received <= 0) {
+				return;
+			}
+			used += received;
+
+			/* everything that arrived is one batch, answered with a single send */
+			size_t offset = 0;
+			while (used - offset >= protocol::HEADER_SIZE) {
+				const uint8_t* header = in.data() + offset;
+				uint32_t size = ReadU32(header);
+				if (size > protocol::MAX_PAYLOAD) {
+					return;
+				}
+				if (used - offset < protocol::HEADER_SIZE + size) {
+					break;
+				}
+				Handle(header[4], ReadU32(header + 8), header + protocol::HEADER_SIZE, size);
+				offset += protocol::HEADER_SIZE + size;
+			}
+			in.erase(in.begin(), in.begin() + offset);
+			used -= offset;
+
+			if (!Flush()) {
+				return;
+			}
+		}
+	}
+
+private:
+	bool Flush() {
+		size_t sent = 0;
+		while (sent < out.size()) {
+			int n = send(socket, (const char*)out.data() + sent, (int)(out.size() - sent), MSG_NOSIGNAL);
+			if (n <= 0) {
+				return false;
+			}
+			sent += n;
+		}
+		out.clear();
+		return true;
+	}
+
+	void Handle(uint8_t command, uint32_t tag, const uint8_t* payload, uint32_t size) {
+		size_t start = out.size();
+		out.resize(start + protocol::HEADER_SIZE, 0);
+		int8_t status = Execute(command, payload, size);
+
+		uint8_t* header = &out[start];
+		uint32_t length = (uint32_t)(out.size() - start - protocol::HEADER_SIZE);
+		for (int k = 0; k < 4; k++) {
+			header[k] = (uint8_t)(length >> (k * 8));
+			header[8 + k] = (uint8_t)(tag >> (k * 8));
+		}
+		header[4] = command;
+		header[5] = (uint8_t)status;
+	}
+
+	Instance* Find(const uint8_t* payload, uint32_t size) {
+		if (size < 4) {
+			return nullptr;
+		}
+		auto it = machines.find(ReadU32(payload));
+		return it != machines.end() ? it->second.get() : nullptr;
+	}
+
+	int8_t Execute(uint8_t command, const uint8_t* payload, uint32_t size) {
+		switch (command) {
+			case protocol::LOAD: {
+				if (size < 4 || payload[0] > (uint8_t)Variant::XOCHIP) {
+					return protocol::BAD_REQUEST;
+				}
+				try {
+					WriteU32(out, server.Load((Variant)payload[0], payload + 4, size - 4));
+				}
+				catch (const std::runtime_error&) {
+					return protocol::ROM_TOO_LARGE;
+				}
+			} break;
+			case protocol::OPEN: {
+				if (size < 8) {
+					return protocol::BAD_REQUEST;
+				}
+				std::unique_ptr<Instance> instance = server.Open(ReadU32(payload), ReadU32(payload + 4));
+				if (!instance) {
+					return protocol::UNKNOWN_HANDLE;
+				}
+				uint32_t id = nextMachine++;
+				machines[id] = std::move(instance);
+				WriteU32(out, id);
+			} break;
+			case protocol::CLOSE: {
+				if (Find(payload, size) == nullptr) {
+					return protocol::UNKNOWN_HANDLE;
+				}
+				auto it = machines.find(ReadU32(payload));
+				server.Close(std::move(it->second));
+				machines.erase(it);
+			} break;
+			case protocol::KEYS: {
+				Instance* instance = Find(payload, size);
+				if (instance == nullptr) {
+					return protocol::UNKNOWN_HANDLE;
+				}
+				if (size < 6) {
+					return protocol::BAD_REQUEST;
+				}
+				SetKeys(instance->machine, ReadU16(payload + 4));
+			} break;
+			case protocol::RUN: {
+				Instance* instance = Find(payload, size);
+				if (instance == nullptr) {
+					return protocol::UNKNOWN_HANDLE;
+				}
+				if (size < 12) {
+					return protocol::BAD_REQUEST;
+				}
+				uint32_t frames = ReadU32(payload + 4);
+				uint32_t cyclesPerFrame = ReadU32(payload + 8);
+				if (frames > protocol::MAX_RUN_FRAMES || cyclesPerFrame > protocol::MAX_CYCLES_PER_FRAME) {
+					return protocol::BAD_REQUEST;
+				}
+				const uint8_t* keys = size > 12 ? payload + 12 : nullptr;
+				if (keys != nullptr && (size - 12) / 2 < frames) {
+					return protocol::BAD_REQUEST;
+				}
+
+				int8_t status = protocol::OK;
+				uint32_t frame = 0;
+				try {
+					for (; frame < frames && instance->machine.GetState() != MachineState::HALTED; frame++) {
+						if (keys != nullptr) {
+							SetKeys(instance->machine, ReadU16(keys + frame * 2));
+						}
+						instance->interpreter.RunFrame(cyclesPerFrame);
+					}
+				}
+				catch (const StackError&) {
+					status = protocol::STACK_ERROR;
+				}
+				catch (const InvalidOpcodeError&) {
+					status = protocol::INVALID_OPCODE;
+				}
+				catch (const std::exception&) {
+					status = protocol::INTERNAL_ERROR;
+				}
+				/* a failed run still reports how far it got */
+				WriteU32(out, frame);
+				out.push_back((uint8_t)instance->machine.GetState());
+				return status;
+			}
+			case protocol::HASH: {
+				Instance* instance = Find(payload, size);
+				if (instance == nullptr) {
+					return protocol::UNKNOWN_HANDLE;
+				}
+				WriteU64(out, HashDisplay(instance->machine.Display()));
+			} break;
+			case protocol::REGISTERS: {
+				Instance* instance = Find(payload, size);
+				if (instance == nullptr) {
+					return protocol::UNKNOWN_HANDLE;
+				}
+				for (int reg = 0; reg < (int)Register::COUNT; reg++) {
+					WriteU16(out, instance->machine.GetRegister((Register)reg));
+				}
+			} break;
+			case protocol::RESET: {
+				Instance* instance = Find(payload, size);
+				if (instance == nullptr) {
+					return protocol::UNKNOWN_HANDLE;
+				}
+				instance->interpreter.Load(server.Image(instance->rom));
+			} break;
+			default:
+				return protocol::BAD_REQUEST;
+		}
+		return protocol::OK;
+	}
+
+	Server& server;
+	Socket socket;
+	uint32_t nextMachine;
+	std::unordered_map<uint32_t, std::unique_ptr<Instance>> machines;
+	std::vector<uint8_t> out;
+};
+
+int main(int argc, const char* argv[]) {
+	if (argc < 2) {
+		std::cout << "Usage " << argv[0] << " <socket path>" << std::endl;
+		return 1;
+	}
+
+#ifdef _WIN32
+	WSADATA wsa;
+	if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+		std::cout << "Failed to start winsock" << std::endl;
+		return 1;
+	}
+#else
+	/* a client that hangs up must fail the send, not kill the daemon */
+	signal(SIGPIPE, SIG_IGN);
+#endif
+
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	size_t length = strlen(argv[1]);
+	if (length >= sizeof(address.sun_path)) {
+		std::cout << "Socket path is too long" << std::endl;
+		return 1;
+	}
+	memcpy(address.sun_path, argv[1], length);
+	remove(argv[1]);
+
+	Socket listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener == INVALID_SOCKET || bind(listener, (const sockaddr*)&address, sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0) {
+		std::cout << "Failed to listen on " << argv[1] << std::endl;
+		return 1;
+	}
+
+	Server server;
+	while (true) {
+		Socket client = accept(listener, nullptr, nullptr);
+		if (client == INVALID_SOCKET) {
+			continue;
+		}
+#ifdef SO_NOSIGPIPE
+		int on = 1;
+		setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+		std::thread([&server, client]() {
+			/* a connection that fails is dropped, the others keep running */
+			try {
+				Connection connection(server, client);
+				connection.Serve();
+			}
+			catch (const std::exception& e) {
+				std::cout << "Dropped a connection: " << e.what() << std::endl;
+			}
+		}).detach();
+	}
+}
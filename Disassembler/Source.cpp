@@ -6,29 +6,72 @@
 #include <fstream>
 #include <iomanip>
 #include <vector>
+#include <stdexcept>
+#include <cstdlib>
 #include <string>
-#include <stack>
 
 #include <Opcode.h>
-#include <Util.h>
+#include <Analysis.h>
+#include <Explorer.h>
+#include <Statistics.h>
 
 using namespace chip8;
 
 static bool show_address = true;
 static bool show_color = false;
 static bool show_bytecode = false;
+static bool explore = false;
+static bool show_stats = false;
+/* how many random patches the analysis is checked against, the listing is not printed if given */
+static uint32_t verify_patches = 0;
+/* the variant the explorer runs the rom as, detected from the static analysis if not given */
+static bool variant_given = false;
+static Variant variant = Variant::CHIP8;
 
-static bool ShouldContinue(const Opcode& prev, const Opcode& opcode) {
-	if (prev.Type() == OpcodeType::SE || prev.Type() == OpcodeType::SNE) {
-		return true;
+/* how much the explorer runs the rom with random input before the listing */
+static const uint32_t EXPLORE_INSTANCES = 1024;
+static const uint32_t EXPLORE_FRAMES = 60 * 60;
+
+/*
+Counts the bytes written to the stream it wraps
+*/
+class CountingBuffer : public std::streambuf {
+public:
+	CountingBuffer(std::streambuf* target) : target(target), count(0) {}
+
+	inline uint64_t Count() const { return count; }
+
+protected:
+	int_type overflow(int_type ch) override {
+		if (traits_type::eq_int_type(ch, traits_type::eof())) {
+			return traits_type::not_eof(ch);
+		}
+		count++;
+		return target->sputc(traits_type::to_char_type(ch));
 	}
-	switch (opcode.Type()) {
-		case OpcodeType::JP:
-		case OpcodeType::JP_V0:
-		case OpcodeType::RET:
-			return false;
-		default:
-			return true;
+
+	std::streamsize xsputn(const char* s, std::streamsize n) override {
+		count += n;
+		return target->sputn(s, n);
+	}
+
+	int sync() override {
+		return target->pubsync();
+	}
+
+private:
+	std::streambuf* target;
+	uint64_t count;
+};
+
+static void PrintStats() {
+	Statistics::Snapshot stats = Statistics::Read();
+	std::cerr << std::dec;
+	for (size_t k = 0; k < Statistics::COUNTERS; k++) {
+		std::cerr << std::setfill(' ') << std::setw(20) << std::left << Statistics::Name((Counter)k) << std::right << stats.counters[k] << std::endl;
+	}
+	for (size_t k = 0; k < Statistics::STAGES; k++) {
+		std::cerr << std::setfill(' ') << std::setw(20) << std::left << Statistics::Name((Stage)k) << std::right << std::fixed << std::setprecision(3) << stats.stages[k] / 1e6 << " ms" << std::endl;
 	}
 }
 
@@ -83,14 +126,24 @@ static void PrintOpcode(const Opcode& opcode) {
 	switch (opcode.Type()) {
 		case OpcodeType::CLS:
 		case OpcodeType::RET:	
+		case OpcodeType::SCR:
+		case OpcodeType::SCL:
+		case OpcodeType::EXIT:
+		case OpcodeType::LOW:
+		case OpcodeType::HIGH:
+		case OpcodeType::AUDIO:
 			setColor(0x4481B8);
-			std::cout << opcode.Type() << " ";
+			std::cout << opcode.Type() << std::endl;
 			break;
 		case OpcodeType::SYS:
 		case OpcodeType::CALL:
 		case OpcodeType::JP:
 		case OpcodeType::SKP: 
-		case OpcodeType::SKNP: {
+		case OpcodeType::SKNP:
+		case OpcodeType::SCD:
+		case OpcodeType::SCU:
+		case OpcodeType::PLANE:
+		case OpcodeType::PITCH: {
 			setColor(0x4481B8);
 			std::cout << opcode.Type() << " ";
 			PrintOperand(opcode.Operand1());
@@ -107,7 +160,8 @@ static void PrintOpcode(const Opcode& opcode) {
 		case OpcodeType::SHR: 
 		case OpcodeType::SUBN: 
 		case OpcodeType::SHL:
-		case OpcodeType::RND: {
+		case OpcodeType::RND:
+		case OpcodeType::LD_LONG: {
 			setColor(0x4481B8);
 			std::cout << opcode.Type() << " ";
 			PrintOperand(opcode.Operand1());
@@ -157,6 +211,38 @@ static void PrintOpcode(const Opcode& opcode) {
 			PrintOperand(opcode.Operand1());
 			std::cout << std::endl;
 		} break;
+		case OpcodeType::SAVE:
+		case OpcodeType::LOAD: {
+			setColor(0x4481B8);
+			std::cout << opcode.Type() << " ";
+			PrintOperand(opcode.Operand1());
+			resetColor();
+			std::cout << " - ";
+			PrintOperand(opcode.Operand2());
+			std::cout << std::endl;
+		} break;
+		case OpcodeType::LD_HFONT:
+		case OpcodeType::LD_RPL_STORE: {
+			setColor(0x4481B8);
+			std::cout << opcode.Type() << " ";
+			setColor(0xCA9F52);
+			std::cout << (opcode.Type() == OpcodeType::LD_HFONT ? "HF" : "R");
+			resetColor();
+			std::cout << ", ";
+			PrintOperand(opcode.Operand1());
+			std::cout << std::endl;
+		} break;
+		case OpcodeType::LD_RPL_LOAD:
+		case OpcodeType::LD_KEY: {
+			setColor(0x4481B8);
+			std::cout << opcode.Type() << " ";
+			PrintOperand(opcode.Operand1());
+			resetColor();
+			std::cout << ", ";
+			setColor(0xCA9F52);
+			std::cout << (opcode.Type() == OpcodeType::LD_KEY ? "K" : "R");
+			std::cout << std::endl;
+		} break;
 		default: {
 			setColor(0xFF0000);
 			std::cout << "<Missing opcode print for " << opcode.Type() << ">" << std::endl;
@@ -173,13 +259,207 @@ static void PrintOpcodeBytes(uint16_t opcode) {
 	std::cout << std::setfill('0') << std::setw(2) << std::hex << (opcode >> 8) << " " << std::setfill('0') << std::setw(2) << std::hex << (opcode & 0xFF) << "\t";
 }
 
+static void PrintJumpTargets(const std::vector<uint16_t>& targets) {
+	if (targets.empty()) {
+		return;
+	}
+	if (show_address) {
+		std::cout << "\t";
+	}
+	resetColor();
+	std::cout << "; ";
+	for (size_t k = 0; k < targets.size(); k++) {
+		setColor(0xBD8EBD);
+		std::cout << std::setfill('0') << std::setw(3) << std::hex << targets[k];
+		resetColor();
+		std::cout << (k + 1 < targets.size() ? ", " : "");
+	}
+	std::cout << std::endl;
+}
+
+static void PrintBlock(const Analysis& analysis, const Analysis::Block& block) {
+	int address = block.start;
+	resetColor();
+	std::cout << "<";
+	setColor(0xBD8EBD);
+	std::cout << std::setfill('0') << std::setw(3) << std::hex << address;
+	resetColor();
+	if (address % 2 != 0) {
+		std::cout << " [unaligned]";
+	}
+	std::cout << ">:" << std::endl;
+
+	for (const Analysis::Instruction& ins : block.code) {
+		if (show_address) {
+			setColor(0xBD8EBD);
+			std::cout << std::setfill('0') << std::setw(3) << std::hex << ins.address << "\t";
+		}
+
+		PrintOpcodeBytes(ins.bin);
+		if (!ins.error.empty()) {
+			setColor(0xFF0000);
+			std::cout << "<" << ins.error << ">" << std::endl;
+			continue;
+		}
+		if (ins.opcode.Length() == 4) {
+			PrintOpcodeBytes(ins.ext);
+		}
+		if (ins.opcode.Type() != OpcodeType::NONE) {
+			PrintOpcode(ins.opcode);
+		}
+		if (ins.opcode.Type() == OpcodeType::JP_V0) {
+			PrintJumpTargets(analysis.JumpTargets(ins.address));
+		}
+	}
+
+	if (block.outOfRange) {
+		if (show_address) {
+			setColor(0xBD8EBD);
+			std::cout << std::setfill('0') << std::setw(3) << std::hex << block.end << "\t";
+		}
+		setColor(0xFF0000);
+		std::cout << "<Outside of range>";
+	}
+
+	std::cout << std::endl;
+	std::cout << std::endl;
+}
+
+static void PrintData(const Analysis& analysis, const Analysis::Region& region) {
+	static const uint32_t BYTES_PER_LINE = 8;
+	const std::vector<uint8_t>& image = analysis.Image();
+
+	resetColor();
+	std::cout << "<";
+	setColor(0xBD8EBD);
+	std::cout << std::setfill('0') << std::setw(3) << std::hex << region.start;
+	resetColor();
+	std::cout << " data>:" << std::endl;
+
+	for (uint32_t line = region.start; line < region.end; line += BYTES_PER_LINE) {
+		if (show_address) {
+			setColor(0xBD8EBD);
+			std::cout << std::setfill('0') << std::setw(3) << std::hex << line << "\t";
+		}
+		setColor(0x99C792);
+		for (uint32_t address = line; address < region.end && address < line + BYTES_PER_LINE; address++) {
+			std::cout << std::setfill('0') << std::setw(2) << std::hex << (int)image[address - analysis.Base()] << (address + 1 < region.end && address + 1 < line + BYTES_PER_LINE ? " " : "");
+		}
+		std::cout << std::endl;
+	}
+
+	resetColor();
+	std::cout << std::endl;
+}
+
+/*
+Return the oldest variant that has every instruction of the reachable code
+and fits the rom, running as a newer one takes paths the rom can not take
+*/
+static Variant DetectVariant(const Analysis& analysis) {
+	Variant detected = Variant::CHIP8;
+	if (analysis.Image().size() > 0x1000 - Analysis::START_ADDRESS) {
+		return Variant::XOCHIP;
+	}
+	for (uint16_t start : analysis.Order()) {
+		for (const Analysis::Instruction& ins : analysis.GetBlock(start).code) {
+			switch (ins.opcode.Type()) {
+				case OpcodeType::SCD:
+				case OpcodeType::SCR:
+				case OpcodeType::SCL:
+				case OpcodeType::EXIT:
+				case OpcodeType::LOW:
+				case OpcodeType::HIGH:
+				case OpcodeType::LD_HFONT:
+				case OpcodeType::LD_RPL_STORE:
+				case OpcodeType::LD_RPL_LOAD:
+					detected = Variant::SCHIP;
+					break;
+				case OpcodeType::SCU:
+				case OpcodeType::SAVE:
+				case OpcodeType::LOAD:
+				case OpcodeType::LD_LONG:
+				case OpcodeType::PLANE:
+				case OpcodeType::AUDIO:
+				case OpcodeType::PITCH:
+					return Variant::XOCHIP;
+				default:
+					break;
+			}
+		}
+	}
+	return detected;
+}
+
+static Analysis Analyse(const uint8_t* rom, size_t size) {
+	Statistics::Timer timer(Stage::ANALYSE);
+	return Analysis(rom, size);
+}
+
+/*
+Will add the code found by running the rom with random input to the analysis,
+returns false if the rom can not be run as the variant
+*/
+static bool Explore(Analysis& analysis, const uint8_t* rom, size_t size) {
+	Statistics::Timer timer(Stage::ANALYSE);
+	try {
+		Explorer explorer(rom, size, variant_given ? variant : DetectVariant(analysis));
+		explorer.Run(EXPLORE_INSTANCES, EXPLORE_FRAMES);
+		explorer.Feed(analysis);
+	}
+	catch (const std::runtime_error& e) {
+		std::cout << "Failed to explore: " << e.what() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+static inline uint32_t NextRandom(uint32_t& state) {
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+/*
+Will patch a copy of the analysis with random words, mostly over its reachable code,
+and compare it with a new analysis after every patch, returns false on the first difference
+*/
+static bool Verify(const Analysis& analysis, uint32_t patches) {
+	Analysis patched = analysis;
+	uint32_t seed = 0x9E3779B9;
+	for (uint32_t n = 0; n < patches; n++) {
+		const std::vector<uint16_t>& order = patched.Order();
+		uint32_t address;
+		if (!order.empty() && (NextRandom(seed) & 1)) {
+			const Analysis::Block& block = patched.GetBlock(order[NextRandom(seed) % order.size()]);
+			address = block.code.empty() ? block.start : block.code[NextRandom(seed) % block.code.size()].address;
+		}
+		else {
+			address = patched.Base() + NextRandom(seed) % std::max<size_t>(patched.Image().size(), 1);
+		}
+		uint32_t word = NextRandom(seed);
+		uint8_t bytes[2] = { (uint8_t)(word >> 8), (uint8_t)word };
+		try {
+			patched.Patch(address, bytes, address + 1 < 0x10000 ? 2 : 1);
+			patched.Verify();
+		}
+		catch (const std::runtime_error& e) {
+			std::cout << "Patch " << std::dec << n + 1 << " at " << std::hex << address << ": " << e.what() << std::endl;
+			return false;
+		}
+	}
+	std::cout << "Verified " << std::dec << patches << " patches" << std::endl;
+	return true;
+}
+
 int main(int argc, const char* argv[]) {
 	if (argc < 2) {
 		std::cout << "Usage " << argv[0] << " <input file>" << std::endl;
 	}
 	else {
 
-		if (argc > 3) {
+		if (argc > 2) {
 			for (int i = 2; i < argc; i++) {
 				if (strcmp(argv[i], "-color") == 0) {
 					show_color = true;
@@ -190,90 +470,71 @@ int main(int argc, const char* argv[]) {
 				else if (strcmp(argv[i], "-no-address") == 0) {
 					show_address = false;
 				}
-			}
-		}
-
-		std::ifstream file(argv[1], std::ios::binary | std::ios::ate);
-		std::streamsize size = file.tellg();
-		file.seekg(0, std::ios::beg);
-		std::vector<char> memory(size);
-
-		if (file.read(memory.data(), size))
-		{
-			std::vector<int> checked;
-			std::stack<int> addresses;
-			addresses.push(0x200);
-			while (!addresses.empty()) {
-				int address = addresses.top();
-				addresses.pop();
-
-				if (address < 0x200) continue;
-				
-				if (std::find(checked.begin(), checked.end(), address) != checked.end()) continue;
-
-				resetColor();
-				std::cout << "<";
-				setColor(0xBD8EBD);
-				std::cout << std::setfill('0') << std::setw(3) << std::hex << address;
-				resetColor();
-				if (address % 2 != 0) {
-					std::cout << " [unaligned]";
+				else if (strcmp(argv[i], "-explore") == 0) {
+					explore = true;
 				}
-				std::cout << ">:" << std::endl;
-
-				Opcode prev(0);
-				Opcode opcode(0);
-				do {
-					checked.push_back(address);
-					bool over = false;
-
-					if (show_address) {
-						setColor(0xBD8EBD);
-						std::cout << std::setfill('0') << std::setw(3) << std::hex << address << "\t";
-					}
-					
-					if (address > (memory.size() - 2) + 0x200) {
-						setColor(0xFF0000);
-						std::cout << "<Outside of range>";
-						break;
-					}
-
-					uint16_t opcode_byte = *(uint16_t*)&memory[address - 0x200];
-					opcode_byte = ToBigEndian(opcode_byte);
-					PrintOpcodeBytes(opcode_byte);
-
-					prev = opcode;
-					try {
-						opcode = Opcode(opcode_byte, true);
+				else if (strcmp(argv[i], "-stats") == 0) {
+					show_stats = true;
+				}
+				else if (strcmp(argv[i], "-verify") == 0 && i + 1 < argc) {
+					verify_patches = (uint32_t)strtoul(argv[++i], nullptr, 10);
+				}
+				else if (strcmp(argv[i], "-variant") == 0 && i + 1 < argc) {
+					const char* name = argv[++i];
+					variant_given = true;
+					if (strcmp(name, "chip8") == 0) {
+						variant = Variant::CHIP8;
 					}
-					catch (std::runtime_error err) {
-						setColor(0xFF0000);
-						std::cout << "<" << err.what() << ">" << std::endl;
-						opcode = Opcode(0);
+					else if (strcmp(name, "schip") == 0) {
+						variant = Variant::SCHIP;
 					}
-					if (opcode.Type() != OpcodeType::NONE) {
-						PrintOpcode(opcode);
+					else if (strcmp(name, "xochip") == 0) {
+						variant = Variant::XOCHIP;
 					}
-
-					// we want to checkout every place we jump into
-					switch (opcode.Type()) {
-						case OpcodeType::JP: {
-							if (opcode.Operand1().GetType() == OperandType::IMMEDIATE) {
-								addresses.push(opcode.Operand1().AsImmediate());
-							}
-						} break;
-						case OpcodeType::CALL: {
-							if (opcode.Operand1().GetType() == OperandType::IMMEDIATE) {
-								addresses.push(opcode.Operand1().AsImmediate());
-							}
-						} break;
+					else {
+						std::cout << "Unknown variant " << name << ", expected chip8, schip or xochip" << std::endl;
+						return 1;
 					}
+				}
+			}
+		}
 
-					address += 2;
-				} while (ShouldContinue(prev, opcode));
+		std::vector<char> memory;
+		bool read;
+		{
+			Statistics::Timer timer(Stage::READ);
+			std::ifstream file(argv[1], std::ios::binary | std::ios::ate);
+			std::streamsize size = file.tellg();
+			file.seekg(0, std::ios::beg);
+			memory.resize(size > 0 ? (size_t)size : 0);
+			read = size >= 0 && file.read(memory.data(), size);
+		}
 
-				std::cout << std::endl;
-				std::cout << std::endl;
+		if (read)
+		{
+			Analysis analysis = Analyse((const uint8_t*)memory.data(), memory.size());
+			if (explore && !Explore(analysis, (const uint8_t*)memory.data(), memory.size())) {
+				return 1;
+			}
+			if (verify_patches > 0) {
+				return Verify(analysis, verify_patches) ? 0 : 1;
+			}
+			{
+				Statistics::Timer timer(Stage::FORMAT);
+				CountingBuffer counter(std::cout.rdbuf());
+				std::streambuf* original = std::cout.rdbuf(&counter);
+				for (uint16_t start : analysis.Order()) {
+					PrintBlock(analysis, analysis.GetBlock(start));
+				}
+				for (const Analysis::Region& region : analysis.DataRegions()) {
+					PrintData(analysis, region);
+				}
+				std::cout.flush();
+				std::cout.rdbuf(original);
+				Statistics::Count(Counter::BYTES_EMITTED, counter.Count());
+			}
+			if (show_stats) {
+				PrintStats();
 			}
 		}
 		else {